@@ -1,769 +1,2310 @@
-/*
-    2-PLAYER CHESS PROGRAM
-
-    ENGR 116 Final Project
-    by Benjamin Knobloch (solo project, Recitation Section RH)
-
-    Program description:
-        * Allows two players to play chess in the terminal.
-        * The board is displayed as a grid of characters.
-            White pieces are uppercase letters and black letters are lowercase.
-            Empty squares are rendered as 0s.
-        * The program will not allow players to make invalid moves.
-        * The program automatically handles checks and checkmates.
-        * You can save and load games to a text file. Multiple games can be saved by using user-chosen IDs.
-        * NOTE: The program does not support castling, but does support promotion and en'passant.
-        * NOTE: The program has an "undo move" feature, but it is currently buggy.
-    
-    How To Move Pieces:
-        * Enter the square of the piece you would like to move, then enter the destination square.
-        * Ranks are denoted by the numbers 1 through 8, and the files are denoted by letters 'a' through 'h'.
-        * Enter the file and then the rank with no space. (For example, enter "e4");
-
-    Sources Used:
-        * http://tutors.ics.uci.edu/index.php/tutor-resources/81-cpp-resources/122-cpp-ref-pointer-operators 
-        * https://stackoverflow.com/questions/12902751/how-to-clone-object-in-c-or-is-there-another-solution
-        * All logic and implementation of chess mechanics is my own.
-
-    To Do:
-        * Implement castling
-        * Fix undo issue
-*/
-
-#include <iostream>
-#include <fstream>
-#include <string>
-#include <math.h>
-#include <vector>
-
-// Class "Piece" is a base class for all pieces on the board.
-class Piece
-{
-    public:
-        bool is_white;
-        bool vulnerable_to_en_passant;
-        bool just_completed_en_passant;
-        Piece()
-        {
-            is_white = true;
-            vulnerable_to_en_passant = false;
-            just_completed_en_passant = false;
-        }
-        // If true, the piece is white.
-        Piece(bool color)
-        {
-            is_white = color;
-        }
-        // move() in each subclass takes origin, destination, and board state, and decides if the piece's move is valid.
-        virtual bool move(int origin, int destination, Piece ** current_board) {return false;};
-        // capture() exists for pawns, since they capture differently than they otherwise move.
-        virtual bool capture(int location, int destination, Piece ** currentBoard) {return move(location, destination, currentBoard);};
-
-        // An empty board still contains a Piece, but it's represented by a 0.
-        virtual char display() {return '0';}
-
-        virtual std::string name()  {return "undefined";}
-
-};
-
-// Class Pawn extends class Piece.
-class Pawn : public Piece
-{
-    public:
-        bool first_move = true;
-        Pawn(bool color) : Piece(color) {};
-        bool move(int location, int destination, Piece ** currentBoard) override
-        {
-            int direction = 1;
-            if (!is_white)   direction = -1;
-            if (first_move)
-            {
-                first_move = false;
-                if (destination == location + 8 * direction)                                                                return true;
-                if (destination == location + 16 * direction && currentBoard[location + 8 * direction]->display() == '0')
-                {
-                    vulnerable_to_en_passant = true;
-                    return true;
-                }
-                return false;
-            }
-            vulnerable_to_en_passant = false;
-            if (destination == location + 7 * direction && destination % 8 != 7)
-            {
-                if (currentBoard[location - 1]->name() == "pawn" && currentBoard[location - 1]->vulnerable_to_en_passant)
-                {
-                    just_completed_en_passant = true;
-                    return true;
-                }
-            }
-            if (destination == location + 9 * direction && destination % 8 != 0)
-            {
-                if (currentBoard[location + 1]->name() == "pawn" && currentBoard[location + 1]->vulnerable_to_en_passant)
-                {
-                    just_completed_en_passant = true;
-                    return true;
-                }
-            }
-
-            if (destination == location + 8 * direction)                                                                    return true;
-            return false;
-        }
-        bool capture(int location, int destination, Piece ** currentBoard) override
-        {
-            int direction = 1;
-            if (!is_white)   direction = -1;
-            if ((destination == location + 7 * direction && destination % 8 != 7) || (destination == location + 9 * direction && destination % 8 != 0)) return true;
-            else                                                                                                                                        return false;
-            return false;
-        }
-        char display () override
-        {
-            if (is_white)   return 'P';
-            else            return 'p';
-        }
-        std::string name () {return "pawn";}
-};
-
-// Class Rook extends class Piece.
-class Rook : public Piece
-{
-    public:
-        Rook(bool color) : Piece(color) {};
-        bool move(int location, int destination, Piece ** currentBoard) override
-        {
-            if (destination % 8 == location % 8)
-            {
-                int direction = 1;
-                if (destination < location) direction = -1;
-                for (int i = location + 8 ; i != destination ; i += 8 * direction)
-                {
-                    if (currentBoard[i]->display() != '0')  return false;
-                }
-                return true;
-            }
-            if (destination / 8 == location / 8)
-            {
-                int direction = 1;
-                if (destination < location) direction = -1;
-                for (int i = location + direction ; i != destination ; i += direction)
-                {
-                    if (currentBoard[i]->display() != '0') return false;
-                }
-                return true;
-            }
-            return false;
-        }
-        char display() override
-        {
-            if (is_white)   return 'R';
-            else            return 'r';
-        }
-        std::string name() {return "rook";}
-};
-
-// Class Knight extends class Piece.
-class Knight : public Piece
-{
-    public:
-        Knight(bool color) : Piece(color) {};
-        bool move(int location, int destination, Piece ** currentBoard) override
-        {
-            int w = std::abs((location % 8) - (destination % 8));
-            int l = std::abs((location / 8) - (destination / 8));
-            if (w == 1 && l == 2) return true;
-            if (w == 2 && l == 1) return true;
-            return false;
-        }
-        char display () override
-        {
-            if (is_white)   return 'N';
-            else            return 'n';
-        }
-        std::string name () {return "knight";}
-};
-
-// Class Bishop extends class Piece.
-class Bishop : public Piece
-{
-    public:
-        Bishop(bool color) : Piece(color) {};
-        bool move(int location, int destination, Piece ** currentBoard) override
-        {
-            int w = std::abs(location % 8 - destination % 8);
-            int l = std::abs(location / 8 - destination / 8);
-
-            if (w == 0) return false;
-            if (w != l) return false;
-
-            int direction_w = 1;
-            if (location % 8 > destination % 8) direction_w = -1;
-            int direction_l = 1;
-            if (location / 8 > destination / 8) direction_l = -1;
-
-            for (int i = location + direction_w + 8 * direction_l ; i != destination ; i += direction_w + 8 * direction_l)
-            {
-                if (i < 8 || i > 55 || i % 8 == 0 || i % 8 == 7)    return false;
-                if (currentBoard[i]->display() != '0')              return false;
-            }
-            return true;
-        }
-        char display () override
-        {
-            if (is_white)   return 'B';
-            else            return 'b';
-        }
-        std::string name () {return "bishop";}
-};
-
-// Class Queen extends class Piece.
-class Queen : public Piece
-{
-    public:
-        Queen(bool color) : Piece(color) {};
-        bool move(int location, int destination, Piece ** currentBoard) override
-        {
-            Rook * test_rook = new Rook(true);
-            Bishop * test_bishop = new Bishop(true);
-            if (test_rook->move(location, destination, currentBoard))    return true;
-            if (test_bishop->move(location, destination, currentBoard))  return true;
-            return false;
-        }
-        char display () override
-        {
-            if (is_white)   return 'Q';
-            else            return 'q';
-        }
-        std::string name () {return "queen";}
-};
-
-// Class King extends class Piece.
-class King : public Piece
-{
-    public:
-        King(bool color) : Piece(color) {};
-        bool move(int location, int destination, Piece ** currentBoard) override
-        {
-            int w = std::abs(location % 8 - destination % 8);
-            int l = std::abs(location / 8 - destination / 8);
-
-            if (w > 1)  return false;
-            if (l > 1)  return false;
-            return true;
-        }
-        char display () override
-        {
-            if (is_white)   return 'K';
-            else            return 'k';
-        }
-        std::string name () {return "king";}
-};
-
-// Class "Board" represents the board
-class Board
-{
-    public:
-        // Creates an array of length 64 where each element represents a square on the board. Numbering travels down the ranks and then the files.
-        Piece * squares [64];
-
-        Board()
-        {
-            // Create empty board.
-            for (int i = 0 ; i < 64 ; i++)  squares[i] = new Piece();
-
-            // Populate board with pieces in standard initial positions.            
-            
-            squares[0] = new Rook(true);
-            squares[1] = new Knight(true);
-            squares[2] = new Bishop(true);
-            squares[3] = new Queen(true);
-            squares[4] = new King(true);
-            squares[5] = new Bishop(true);
-            squares[6] = new Knight(true);
-            squares[7] = new Rook(true);
-            for (int i = 8 ; i < 16 ; i++)      squares[i] = new Pawn(true);
-
-            for (int i = 48 ; i < 56 ; i++)     squares[i] = new Pawn(false);
-            squares[56] = new Rook(false);
-            squares[57] = new Knight(false);
-            squares[58] = new Bishop(false);
-            squares[59] = new Queen(false);
-            squares[60] = new King(false);
-            squares[61] = new Bishop(false);
-            squares[62] = new Knight(false);
-            squares[63] = new Rook(false);
-            
-
-        }
-
-        // If the move results in a promotion, execute that promotion.
-        void check_promotion(Piece p, int location, bool is_white)
-        {
-            if (((is_white && location >= 56) || (!is_white && location <= 7)) && (p.display() == 'p' || p.display() == 'P'))
-            {
-                std::string choice = "";
-                std::cout << "\n\nPromotion! What piece would you like to promote to?";
-                while (choice != "q" && choice != "b" && choice != "n" && choice != "r")
-                {
-                    std::cout << "\nType \"q\" for queen, \"b\" for bishop, etc.: ";
-                    std::cin >> choice;
-                }
-                if (choice == "q")      squares[location] = new Queen(is_white);
-                else if (choice == "b") squares[location] = new Bishop(is_white);
-                else if (choice == "n") squares[location] = new Knight(is_white);
-                else                    squares[location] = new Rook(is_white);
-            }
-        }
-
-        // move() in Board handles the move on each turn.
-        int move(bool white_turn, int origin, int destination)
-        {
-            // If the origin and destination locations are identical, return error code -1.
-            if (origin == destination)
-            {
-                return -1;
-            }
-            // If the origin location contains no piece, return error code -2.
-            if (squares[origin]->display() == '0')
-            {
-                return -2;
-            }
-            // If the origin location contains a piece of the wrong color, return error code -3.
-            if (white_turn != squares[origin]->is_white)
-            {
-                return -3;
-            }
-            // If the destination location is empty, use the piece's .move() method.
-            if (squares[destination]->display() == '0')
-            {
-                if (squares[origin]->move(origin, destination, squares))
-                {
-                    squares[destination] = squares[origin];
-                    check_promotion(squares[origin], destination, white_turn);
-                    squares[origin] = new Piece();
-                    
-                    // Handle en_passant situations.
-                    if (squares[destination]->just_completed_en_passant)
-                    {
-                        if (destination > origin)
-                        {
-                            squares[destination - 8] = new Piece();
-                            (*squares)[destination].just_completed_en_passant = false;
-                        }
-                        else
-                        {
-                            squares[destination + 8] = new Piece();
-                            (*squares)[destination].just_completed_en_passant = false;
-                        }
-                    }
-                    
-                    return 1;
-                }
-                // If the piece can't move to the destination, return error code -4.
-                return -4;
-            }
-            else
-            {
-                // If the destination location contains a piece of the same color as the current player's piece, return error code -5.
-                if (white_turn == squares[destination]->is_white)
-                {
-                    return -5;
-                }
-                // If the destination location contains a piece of the opposite color, use the piece's .capture() method.
-                if (squares[origin]->capture(origin, destination, squares))
-                {
-                    squares[destination] = squares[origin];
-                    check_promotion(squares[origin], destination, white_turn);
-                    squares[origin] = new Piece();
-                    return 2;
-                }
-                return -7;
-            }
-            return -6;
-        }
-        
-        // Display the board by printing each piece's char symbol using .display().
-        void render() {
-            std::cout << "\n\t\t\t    a b c d e f g h";
-            std::cout << "\n\t\t\t  -------------------";
-            for (int i = 56 ; i > -1 ; i-= 8)
-            {
-                for (int j = 0 ; j < 8 ; j++)
-                {
-                    if (j % 8 == 0) std::cout << "\n\t\t\t" << (i / 8) + 1 << " | ";
-                    std::cout << squares[i + j]->display() << " ";
-                    if (j % 8 == 7) std::cout << "|";
-                }
-            }
-            std::cout << "\n\t\t\t  -------------------\n";
-        }
-        
-        // Return a copy, or a clone, of the board.
-        Board clone()
-        {
-            return (*this);
-        }
-
-};
-
-// chess_notation_to_integer() accepts a string in chess notation (i.e. "e4") and returns the corresponding array location.
-int chess_notation_to_integer(std::string code) {
-    int file = -1;
-    std::string str_file = code.substr(0, 1);
-    std::string letters = "abcdefgh";
-    std::string u_letters = "ABCDEFGH";
-    
-    file = letters.find(str_file, 0);
-    if (file == std::string::npos)   file = u_letters.find(str_file, 0);
-
-    int rank = std::stoi(code.substr(1, 1));
-
-    return (8 * (rank - 1)) + file;
-}
-
-// check_for_check() returns true if the king of the given color is in check.
-bool check_for_check(Board * currentBoard, bool white) {
-    
-    int king_location = -1;
-    for (int i = 0 ; i < 64 ; i++)
-    {
-        if ((white && currentBoard->squares[i]->display() == 'K') || (!white && currentBoard->squares[i]->display() == 'k')) {
-            king_location = i;
-        }
-    }
-
-    Piece king = currentBoard->squares[king_location];
-
-    for (int i = 0 ; i < 64 ; i++)
-    {
-        if (currentBoard->squares[i]->display() != '0' && currentBoard->squares[i]->is_white != white)
-        {
-            if (currentBoard->squares[i]->capture(i, king_location, currentBoard->squares))   return true;
-        }
-    }
-
-    return false;
-
-}
-
-// check_for_checkmate() returns true if the king of the given color is in checkmate.
-bool check_for_checkmate(Board currentBoard, bool whites_turn) {
-
-    int king_location = -1;
-    for (int i = 0 ; i < 64 ; i++)
-    {
-        if ((whites_turn && currentBoard.squares[i]->display() == 'K') || (!whites_turn && currentBoard.squares[i]->display() == 'k'))
-        {
-            king_location = i;
-        }
-    }
-
-    Piece king = currentBoard.squares[king_location];
-
-    for (int i = 0 ; i < 64 ; i++)
-    {
-        for (int j = 0 ; j < 64 ; j++)
-        {
-            Board b = currentBoard.clone();
-            if (b.squares[i]->is_white == !whites_turn)
-            {
-                if (b.squares[i]->move(i, j, b.squares) || b.squares[i]->capture(i, j, b.squares))
-                {
-                    b.move(!whites_turn, i, j);
-                    if (!check_for_check(&b, king_location))    return false;
-                }
-            }
-        }
-    }
-
-    return true;
-
-}
-
-bool save_to_file(std::vector <std::string> moves, bool whites_turn, std::string id) {
-    try
-    {
-        std::ofstream save_file;
-        save_file.open("saved_chess_game_" + id, std::ios::trunc);
-
-        if (whites_turn)
-        {
-            save_file << "w";
-        } else
-        {
-            save_file << "b";
-        }
-        save_file << "\n";
-
-        int counter = 0;
-        for (std::string move : moves)
-        {
-            if (counter == 2) {
-                save_file << "\n";
-                counter = 0;
-            }
-            else if (counter == 1)    save_file << " ";
-
-            save_file << move;
-
-            counter++;
-        }
-
-        save_file.close();
-        
-        return true;
-    }
-    catch (...)
-    {
-        return false;
-    }
-    return false;
-}
-
-std::vector <std::string> load_from_file(std::string id) {
-    try
-    {
-        std::ifstream load_file("saved_chess_game_" + id);
-
-        std::vector <std::string> moves = {};
-        std::string line;
-        if (load_file.is_open())
-        {
-            while (std::getline (load_file, line))
-            {
-                moves.push_back(line);
-            }
-            load_file.close();
-        }
-
-        return moves;
-
-    }
-    catch (...)
-    {
-        return {};
-    }
-    
-    return {};
-
-}
-
-// Main program loop allows players to create a board and play a game.
-int main() {
-
-    bool game_in_progress = true;
-
-    std::cout << "\n\n\n\t\t\tHello! Welcome to Benjamin Knobloch's C++ Chess Program.\n\n\n";
-
-    bool need_start_response = true;
-    Board my_board;
-    std::vector <std::string> move_list = {};
-    bool whites_turn;
-
-    std::string start_response = "";
-    while (need_start_response)
-    {
-        std::cout << "\n\n\t\t\tWould you like to start a new game? (Y)es, (L)oad existing game, or (N)o: ";
-        std::cin >> start_response;
-
-        if (start_response == "l" || start_response == "L")
-        {
-            std::string saved_id;
-            std::cout << "\n\n\t\t\tType the ID of a saved game to load it: ";
-            std::cin >> saved_id;
-
-            std::vector <std::string> saved_data = load_from_file(saved_id);
-            if (saved_data.size() == 0)
-            {
-                std::cout << "\n\t\t\tError loading saved game.";
-            }
-            else
-            {
-                std::cout << "\n\t\t\tSaved game successfully located. Loading...";
-                need_start_response = false;
-                int i = 0;
-                std::string o, d;
-                bool alternator = true;
-                for (std::string l : saved_data)
-                {
-                    if (i == 0)
-                    {
-                        if (l == "w")   whites_turn = true;
-                        if (l == "b")   whites_turn = false;
-                    }
-                    else
-                    {
-                        o = l.substr(0, 2);
-                        d = l.substr(3, 2);
-                        if (my_board.move(alternator, chess_notation_to_integer(o), chess_notation_to_integer(d)) < 0)
-                        {
-                            std::cout << "\n\t\t\tThat save doesn't describe a valid game!";
-                            need_start_response = true;
-                            break;
-                        }
-                        else
-                        {
-                            move_list.push_back(o);
-                            move_list.push_back(d);
-                        }
-
-                        alternator = !alternator;
-                    }
-
-                    i++;
-                }
-            }
-
-        }
-        if (start_response == "n" || start_response == "N")
-        {
-            std::cout << "\n\n\t\t\tOkay. Have a good day!";
-            game_in_progress = false;
-            need_start_response = false;
-        }
-        if (start_response == "y" || start_response == "Y")
-        {
-            std::cout << "\n\n\t\t\tIf you wish to save your game at any point, type \"S\" instead of a move.";
-            whites_turn = true;
-            need_start_response = false;
-        }
-    }
-
-    
-
-    std::cout << "\n\n";
-    my_board.render();
-    
-    Board board_copy;
-    while (game_in_progress)
-    {
-
-        std::cout << "\n\t====================\n";
-
-        if (whites_turn)    std::cout << "\n\tIt is white's turn. (uppercase characters)";
-        else                std::cout << "\n\tIt is black's turn. (lowercase characters)";
-
-        bool looking_for_valid_move = true;
-
-        std::string o, d;
-        while (looking_for_valid_move)
-        {
-
-            std::cout << "\n\tWhat piece would you like to move? Or would you like to (U)ndo, (V)iew move list, or (S)ave this game?: ";
-            std::cin >> o;
-
-            if (o == "s" || o == "S")
-            {             // Save game.
-                std::string save_id;
-                std::cout << "\n\nPlease give your saved game a string ID. When you want to load this game, use the ID to do so: ";
-                std::cin >> save_id;
-                while (save_id == "")
-                {
-                    std::cout << "\nPlease enter an ID: ";
-                    std::cin >> save_id;
-                }
-                if(save_to_file(move_list, whites_turn, save_id))   std::cout << "\n\n\t\t\tSave successful.";
-                else                                                std::cout << "\n\n\t\t\tSave failed. Please try again.";
-            }
-            else if (o == "u" || o == "U")
-            {
-                my_board = board_copy.clone();
-                for (int i = 0 ; i < 2 ; i ++)
-                {
-                    move_list.pop_back();
-                }
-                std::cout << "\n\tUndo move successful.\n";
-                looking_for_valid_move = false;
-            }
-            else if (o == "v" || o == "V")
-            {
-                int iterator = 0;
-                bool alternator = true;
-                std::cout << "\n\n\t====================\n";
-                for (std::string move : move_list)
-                {
-                    if (iterator == 2)
-                    {
-                        std::cout << "\n";
-                        iterator = 0;
-                    }
-                    if (iterator == 1)
-                    {
-                        std::cout << " to ";
-                    }
-                    if (iterator == 0)
-                    {
-                        if (alternator) std::cout << "\tWhite moved from ";
-                        else            std::cout << "\tBlack moved from ";
-                        alternator = !alternator;
-                    }
-
-                    std::cout << move;
-
-                    iterator++;
-                }
-                if (move_list.size() == 0) {
-                    std::cout << "This is a brand new game! There have been no moves so far.";
-                }
-                std::cout << "\n\t====================\n\n";
-                whites_turn = !whites_turn;
-                looking_for_valid_move = false;
-            }
-            else
-            {
-                std::cout << "\tWhere do you move it?: ";
-                std::cin >> d;
-
-                board_copy = my_board.clone();
-
-                try
-                {
-                    int move_result = my_board.move(whites_turn, chess_notation_to_integer(o), chess_notation_to_integer(d));
-                    if (move_result > 0)
-                    {
-                        move_list.push_back(o);
-                        move_list.push_back(d);
-                        looking_for_valid_move = false;
-                    }
-                    else
-                    {
-                        std::cout << "\n\n\tThat move is not valid.";
-                        if (move_result == -1)  std::cout << " Origin square and destination square must be distinct.";
-                        if (move_result == -2)  std::cout << " The origin square must contain a piece.";
-                        if (move_result == -3)  std::cout << " The origin square must contain a piece of your color.";
-                        if (move_result == -4)  std::cout << " That piece cannot be moved to the designated destination square.";
-                        if (move_result == -5)  std::cout << " The destination square cannot contain one of your own pieces.";
-                        if (move_result == -7)  std::cout << " That piece can't capture like that.";
-                    }
-                }
-                catch (...)
-                {
-                    std::cout << "\n\n\tThat move is not valid. Enter piece locations as \"A1\", \"E4\", etc.";
-                }
-
-                if (check_for_check(&my_board, whites_turn))
-                {
-                    std::cout << "\n\n\tYou can't end your turn in check.";
-                    my_board = board_copy;
-                    looking_for_valid_move = true;
-                }
-            }
-        }
-        
-        my_board.render();
-
-        if (check_for_check(&my_board, !whites_turn))
-        {
-            if (check_for_checkmate(my_board, whites_turn))
-            {
-                std::cout << "\n\n\t\t======================================";
-                std::cout << "\n\t\t\t\tCHECKMATE!\n\n";
-                std::cout << "\n\t\t======================================";
-                game_in_progress = false;
-            } else  std::cout << "\n\t\t\t\tCheck!\n";
-        }
-
-        whites_turn = !whites_turn;
-    }
-
-    return 1;
+/*
+    2-PLAYER CHESS PROGRAM
+
+    ENGR 116 Final Project
+    by Benjamin Knobloch (solo project, Recitation Section RH)
+
+    Program description:
+        * Allows two players to play chess in the terminal.
+        * The board is displayed as a grid of characters.
+            White pieces are uppercase letters and black letters are lowercase.
+            Empty squares are rendered as 0s.
+        * The program will not allow players to make invalid moves.
+        * The program automatically handles checks and checkmates.
+        * You can save and load games to a text file. Multiple games can be saved by using user-chosen IDs.
+        * Saving a game starts a binary journal (saved_chess_game_<ID>.journal). After that, every move is added to it as soon as it is played.
+        * "chess journal test <path>" saves a game to a journal, loads it, plays on and loads it again, to check that a continued journal still reads back whole.
+        * Games can also be exported to the old text format, which ends with a FEN snapshot of the position so loading it doesn't replay the game.
+        * Broken saves are rejected with the reason, and the line of a text save where the problem is.
+        * A game can start from any position given as a FEN string, and typing "F" shows the FEN of the current position.
+        * NOTE: The program does not support castling, but does support promotion and en'passant.
+        * Moves can be undone one at a time, all the way back to the start of the game.
+        * Typing "M" and then a square lists every square the piece there can legally move to.
+        * You can play against the computer, which searches for its moves within a time limit and reports how deep it looked.
+        * When playing the computer, undo takes back your last move and the computer's reply together.
+        * While you think, the computer keeps searching the reply it expects from you. If you play it, the computer answers right away.
+    
+    How To Move Pieces:
+        * Enter the square of the piece you would like to move, then enter the destination square.
+        * Ranks are denoted by the numbers 1 through 8, and the files are denoted by letters 'a' through 'h'.
+        * Enter the file and then the rank with no space. (For example, enter "e4");
+
+    Building:
+        * The chess rules and engine live in a library, libtextchess (textchess.h and textchess.cpp), which never reads or writes the terminal.
+        * Build the library with "g++ -std=c++17 -O2 -c textchess.cpp && ar rcs libtextchess.a textchess.o".
+        * Build the game with "g++ -std=c++17 -O2 -pthread chess.cpp -L. -ltextchess -o chess".
+        * Adding -mavx2 to both commands lets the full evaluation recompute, used when a position is set up, work on 16 squares at a time instead of 8.
+        * Adding -DTEXTCHESS_CHECK_EVAL to both commands checks after every move and take-back that the evaluation kept up to date by each move matches a full recompute, and stops with an assertion if it doesn't.
+
+    Perft Mode:
+        * "chess perft <depth> [fen]" counts every position reachable in <depth> moves and reports nodes/second.
+        * "chess perft divide <depth> [fen]" also prints the count below each first move, to narrow down move generation bugs.
+        * "chess perft file perft_positions.epd [max depth]" checks a suite of positions against their known counts, and that the FEN loader rejects the broken positions listed in it.
+        * Perft also counts heap allocations. Playing and taking back moves should never allocate, and the file check fails if it does.
+        * "chess bench [depth]" searches a fixed set of positions to the given depth (default 7) and reports the total nodes/second, and how often each search found its pawn structure already scored in its pawn table.
+        * "chess bench smp [depth]" searches the same positions with 1 to 16 threads and reports the speedup in time to depth.
+        * "chess bench check [rounds]" times check detection and king move safety read from the attack maps the board keeps, against working them out from scratch.
+
+    UCI Mode:
+        * "chess --uci" speaks the UCI protocol on standard input and output instead of showing the board, so other programs can drive it.
+        * It understands uci, isready, setoption (Hash, Threads), ucinewgame, position (startpos or fen, then moves), go (depth, movetime, nodes, wtime/btime, infinite), stop and quit.
+
+    Game Database:
+        * "chess db build games.db saved_chess_game_*" gathers any number of saved games, journals or text saves, into one database file.
+        * "chess db query games.db [fen]" lists the games that reached a position (default the start position), what was played next in them, and how long the lookup took.
+        * The database keeps every position reached in a sorted index, and is read through a memory map, so a lookup is a binary search that only touches a few pages of the file.
+
+    Replay Mode:
+        * "chess replay <files or directories...>" checks saved games and PGN files by playing every move through the move validator, for example after a rule fix.
+        * Each game gets a verdict: legal with its final result, or the ply of its first illegal move and why.
+        * Directories are searched for saved_chess_game_* and *.pgn files. PGN files are read a game at a time, so they can be any size.
+        * The games are shared between threads=<count> workers (For example, "chess threads=8 replay saves/"), and the total is reported in games/second.
+        * Castling isn't supported yet, so PGN games that castle are reported as illegal at that move.
+
+    Match Mode:
+        * "chess match <games> <engine A> <engine B>" plays the engine against itself with two sets of search settings, to measure the effect of a change.
+        * Engine settings are name=value pairs joined by commas, from depth, nodes, movetime, time (a clock for the whole game, in milliseconds), inc and hash (For example, "chess match 200 nodes=20000 nodes=40000").
+        * "openings <file>" starts the games from a file of FEN or EPD lines. Each opening is played twice, once with each engine as white.
+        * Games end at checkmate, stalemate, threefold repetition, the 50-move rule, or a flag falling.
+        * threads=<count> plays that many games at once, each with its own board, search and transposition tables.
+        * The results are reported as wins, losses and draws, an Elo difference with a 95% error margin, and each engine's nodes/second.
+        * "pgn <file>" writes the games in PGN, and "journals <directory>" writes each game as a journal that can be loaded or replayed.
+
+    Opening Book:
+        * Start the program with book=<file> and the computer plays its first moves from an opening book instead of searching them, in the game, UCI mode and matches.
+        * Book moves are chosen at random, with the more recommended ones more likely. Typing "B" during a game lists the book moves for the position.
+        * "chess book build <book> <plies> <saved games or PGN files...>" makes a book from the first <plies> moves of each game. A move counts 2 for each win, and 1 for each draw or unfinished game.
+        * "chess book probe <book> [fen]" lists the book moves for a position and how long the lookup took.
+        * Books use the Polyglot file layout and keys, and are searched in place through a memory map. The Random64 entries for queens and kings still have to be copied into textchess.cpp. Until then books are keyed by this program's own position keys, so books made by other Polyglot tools won't match.
+        * "chess book test" checks the keys against the ones published with the format. It fails for every position until the queen and king entries are in.
+
+    Tablebases:
+        * "chess tb generate <directory> <pieces...>" works out every position with up to 5 pieces by retrograde analysis, and saves the result as a table for each set of pieces (For example, "chess tb generate tb KRvK KPvK", or "chess tb generate tb 4" for every 4-piece table).
+        * The tables that captures and promotions lead to are made first. Each table's positions, wins, draws, losses, longest mate, time and memory are reported.
+        * threads=<count> shares each table's work between that many threads. The tables are the same however many threads make them.
+        * Start the program with tb=<directory> and the search knows the result and distance to mate of every position in the tables, and matches end as soon as a game reaches one.
+        * "chess tb probe <directory> <fen>" shows whether the side to move wins, draws or loses, in how many plies, and the best move.
+        * Tables don't know about en passant rights or the 50-move rule. 5-piece tables take several minutes and a few gigabytes of memory to make.
+
+    Startup Options:
+        * Options are given as name=value before anything else on the command line (For example, "chess hash=64").
+        * hash=<megabytes> sets the size of the transposition table used by searches (default 16).
+        * movetime=<milliseconds> sets how long the computer thinks about each move (default 1000).
+        * nodes=<count> also stops the computer after searching that many positions (default 0, meaning no limit).
+        * threads=<count> searches with that many threads at once, sharing the transposition table, and sets how many games "chess replay" and "chess match" work on at once (default 1).
+        * ponder=0 stops the computer from thinking while it waits for your move (default 1).
+        * snapshot=0 leaves the FEN snapshot out of saves, so loading replays every move and they can all be undone (default 1).
+        * book=<file> sets the opening book the computer plays from (default none).
+        * tb=<directory> sets the endgame tablebases the computer looks positions up in (default none).
+
+    Sources Used:
+        * http://tutors.ics.uci.edu/index.php/tutor-resources/81-cpp-resources/122-cpp-ref-pointer-operators 
+        * https://stackoverflow.com/questions/12902751/how-to-clone-object-in-c-or-is-there-another-solution
+        * All logic and implementation of chess mechanics is my own.
+
+    To Do:
+        * Implement castling
+*/
+
+#include "textchess.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+#include <algorithm>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <filesystem>
+#include <cmath>
+#include <random>
+#include <functional>
+#include <cctype>
+
+// Every heap allocation the program makes is counted here, so perft can show that playing and taking back moves never allocates.
+std::atomic <uint64_t> allocation_count(0);
+
+// These are kept out of line, or GCC sees malloc() paired with delete, or free() with new, and warns about a mismatch that isn't there.
+__attribute__((noinline)) void * operator new(size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void * p = std::malloc(size ? size : 1))    return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void * p) noexcept           {std::free(p);}
+__attribute__((noinline)) void operator delete(void * p, size_t) noexcept   {std::free(p);}
+
+// render() displays the board by printing each square's char symbol using .display().
+void render(const Board & board) {
+    std::cout << "\n\t\t\t    a b c d e f g h";
+    std::cout << "\n\t\t\t  -------------------";
+    for (int i = 56 ; i > -1 ; i-= 8)
+    {
+        for (int j = 0 ; j < 8 ; j++)
+        {
+            if (j % 8 == 0) std::cout << "\n\t\t\t" << (i / 8) + 1 << " | ";
+            std::cout << board.display(i + j) << " ";
+            if (j % 8 == 7) std::cout << "|";
+        }
+    }
+    std::cout << "\n\t\t\t  -------------------\n";
+}
+
+
+// ask_promotion() asks the player which piece a pawn reaching the last rank should become, and returns its type.
+int ask_promotion() {
+    std::string choice = "";
+    std::cout << "\n\nPromotion! What piece would you like to promote to?";
+    while (choice != "q" && choice != "b" && choice != "n" && choice != "r")
+    {
+        std::cout << "\nType \"q\" for queen, \"b\" for bishop, etc.: ";
+        std::cin >> choice;
+    }
+    if (choice == "q")      return QUEEN;
+    else if (choice == "b") return BISHOP;
+    else if (choice == "n") return KNIGHT;
+    else                    return ROOK;
+}
+
+// read_move() turns a player's text into a legal move, looking it up in the legal moves worked out at the start of the turn.
+// If a pawn reaches the last rank without a promotion piece, it asks for one.
+MoveError read_move(const Board & board, const LegalMoves & legal, std::string text, Move & move) {
+    MoveError error = parse_move(board, text, move);
+    if (error == MOVE_OK)   error = validate_move(board, legal, move);
+    if (error == PROMOTION_REQUIRED)
+    {
+        move = Move(move.origin(), move.destination(), PROMOTION, ask_promotion());
+        error = validate_move(board, legal, move);
+    }
+    return error;
+}
+
+// run_perft() runs perft on one position and prints the node count and speed. With divide, it also prints the count below each root move.
+uint64_t run_perft(Board & board, int depth, bool divide) {
+
+    UndoStack history;
+    uint64_t allocations = allocation_count;
+    auto start = std::chrono::steady_clock::now();
+
+    uint64_t nodes = 0;
+    if (divide && depth > 0)
+    {
+        MoveList list;
+        generate_legal_moves(board, list);
+        for (Move m : list)
+        {
+            board.make_move(m, history);
+            uint64_t count = perft(board, history, depth - 1);
+            board.unmake_move(history);
+            std::cout << move_to_string(m) << ": " << count << "\n";
+            nodes += count;
+        }
+        std::cout << "\n";
+    }
+    else    nodes = perft(board, history, depth);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Depth " << depth << ": " << nodes << " nodes in " << (int)(seconds * 1000) << " ms";
+    if (seconds > 0)    std::cout << " (" << (uint64_t)(nodes / seconds) << " nodes/second)";
+    std::cout << "\n";
+    if (!divide)        std::cout << "Heap allocations: " << allocation_count - allocations << "\n";
+    return nodes;
+
+}
+
+// run_perft_file() checks every position in an EPD perft suite, where each line is a FEN followed by expected counts (i.e. "<fen> ;D1 20 ;D2 400").
+// A line whose only entry is ";invalid" holds a FEN the loader must reject. Depths above max_depth are skipped.
+// It returns the number of counts that didn't match or FENs wrongly accepted, plus one if the move path allocated any memory.
+int run_perft_file(std::string path, int max_depth) {
+
+    std::ifstream suite(path);
+    if (!suite.is_open())
+    {
+        std::cout << "Could not open " << path << "\n";
+        return 1;
+    }
+
+    int failures = 0;
+    uint64_t total_nodes = 0;
+    uint64_t move_path_allocations = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::string line;
+    while (std::getline(suite, line))
+    {
+        size_t split = line.find(';');
+        if (line.empty() || line[0] == '#' || split == std::string::npos)    continue;
+
+        std::string fen = line.substr(0, split);
+        Board board;
+        std::string reason;
+        if (line.compare(split, std::string::npos, ";invalid") == 0)
+        {
+            bool rejected = !board.from_fen(fen, &reason);
+            std::cout << fen << "\n\t" << (rejected ? "rejected ok (" + reason + ")" : "FAILED (accepted)") << "\n";
+            if (!rejected)  failures++;
+            continue;
+        }
+        if (!board.from_fen(fen))
+        {
+            std::cout << "Bad FEN: " << fen << "\n";
+            failures++;
+            continue;
+        }
+
+        std::cout << fen << "\n";
+        // Each expectation after the FEN reads ";D<depth> <count>".
+        std::istringstream entries(line.substr(split));
+        std::string entry;
+        unsigned long long expected;
+        while (std::getline(entries, entry, ';'))
+        {
+            int depth;
+            if (std::sscanf(entry.c_str(), " D%d %llu", &depth, &expected) != 2 || depth > max_depth)  continue;
+            UndoStack history;
+            uint64_t allocations = allocation_count;
+            uint64_t nodes = perft(board, history, depth);
+            move_path_allocations += allocation_count - allocations;
+            total_nodes += nodes;
+            std::cout << "\tD" << depth << " " << nodes;
+            if (nodes == expected)  std::cout << " ok\n";
+            else
+            {
+                std::cout << " FAILED (expected " << expected << ")\n";
+                failures++;
+            }
+        }
+    }
+
+    if (move_path_allocations > 0)
+    {
+        std::cout << "\nFAILED: the move path made " << move_path_allocations << " heap allocations.";
+        failures++;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "\n" << failures << " failures, " << total_nodes << " nodes in " << (int)(seconds * 1000) << " ms";
+    if (seconds > 0)    std::cout << " (" << (uint64_t)(total_nodes / seconds) << " nodes/second)";
+    std::cout << "\n";
+    return failures;
+
+}
+
+// perft_command() handles "chess perft ...". Its arguments are one of:
+//     [divide] <depth> [fen]      count the positions below the start position or the given FEN
+//     file <path> [max depth]     check every position in an EPD perft suite
+int perft_command(int argc, char * argv[]) {
+
+    std::vector <std::string> args(argv, argv + argc);
+    try
+    {
+        if (args.size() >= 2 && args[0] == "file")
+        {
+            int max_depth = args.size() >= 3 ? std::stoi(args[2]) : 64;
+            return run_perft_file(args[1], max_depth) == 0 ? 0 : 1;
+        }
+
+        bool divide = !args.empty() && args[0] == "divide";
+        if (divide) args.erase(args.begin());
+        if (args.empty())   throw std::invalid_argument("missing depth");
+
+        int depth = std::stoi(args[0]);
+        std::string fen;
+        for (size_t i = 1 ; i < args.size() ; i++)  fen += args[i] + " ";
+
+        Board board;
+        if (!fen.empty() && !board.from_fen(fen))
+        {
+            std::cout << "Bad FEN: " << fen << "\n";
+            return 1;
+        }
+        run_perft(board, depth, divide);
+        return 0;
+    }
+    catch (...)
+    {
+        std::cout << "Usage: chess perft [divide] <depth> [fen]\n       chess perft file <path> [max depth]\n";
+        return 1;
+    }
+
+}
+
+// pawn_hit_rate() returns the share of a search's pawn table lookups that found their pawns, in percent.
+int pawn_hit_rate(const Search & search) {
+    uint64_t hits, probes;
+    search.pawn_stats(hits, probes);
+    return probes ? (int)(100 * hits / probes) : 0;
+}
+
+// print_iteration() is the search report used in play: one line per iteration, for comparing engine speed across builds.
+void print_iteration(const Search & search) {
+    int ms = std::max(search.elapsed(), 1);
+    std::cout << "\n\tdepth " << search.completed_depth << "  score " << score_to_string(search.best_score);
+    std::cout << "  nodes " << search.total_nodes() << "  nps " << search.total_nodes() * 1000 / ms << "  time " << ms << " ms";
+    std::cout << "  pawn hits " << pawn_hit_rate(search) << "%  pv";
+    for (int i = 0 ; i < search.pv_length ; i++)    std::cout << " " << move_to_string(search.pv[i]);
+}
+
+// Class "Ponder" keeps the computer thinking while its opponent decides on a move. It plays the reply the computer
+// expects onto a copy of the board and searches the result on a background thread with no limits. If the expected move
+// is played, that search carries on until the computer's time is up and its move is used. Otherwise it is stopped, and
+// only what it left in the transposition table is kept.
+class Ponder
+{
+    public:
+        ~Ponder() {cancel();}
+
+        // start() begins searching the position after predicted is played on the given board.
+        void start(const Board & position, const UndoStack & moves, Move predicted, int threads)
+        {
+            cancel();
+            board = position;
+            history = moves;
+            board.make_move(predicted, history);
+            guess = predicted;
+            key = board.key;
+            SearchLimits limits;
+            limits.threads = threads;
+            search.reset(new Search(board, history, limits));
+            search->report = nullptr;
+            started = std::chrono::steady_clock::now();
+            finished = false;
+            thread = std::thread([this] {search->run(); finished = true;});
+        }
+
+        // finish() is called once the opponent has played, with current the board after their move. If they played the predicted
+        // move and reached the position the search started from, it lets the search run until movetime milliseconds have passed
+        // since it started, puts its move in best and the reply it expects to that in expected, and returns true.
+        // Either way, the search is stopped and forgotten.
+        bool finish(const Board & current, Move played, int movetime, Move & best, Move & expected)
+        {
+            if (!search)    return false;
+            bool hit = played == guess && current.key == key;
+            while (hit && !finished && thought_for() < movetime)    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            stop();
+            hit = hit && search->completed_depth > 0;
+            if (hit)
+            {
+                best = search->best_move;
+                expected = search->pv_length >= 2 ? search->pv[1] : Move();
+                print_iteration(*search);
+            }
+            cancel();
+            return hit;
+        }
+
+        // cancel() stops the search, if there is one, and forgets it and the predicted move, so nothing it found can be played later.
+        void cancel()
+        {
+            stop();
+            search.reset();
+            guess = Move();
+            key = 0;
+        }
+
+        // Milliseconds since the search started, counting the time the opponent spent thinking.
+        int thought_for() const
+        {
+            return (int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+        }
+
+    private:
+        Board board;
+        UndoStack history;
+        Move guess;
+        // The key of the position the search started from, after the predicted move.
+        uint64_t key = 0;
+        std::unique_ptr <Search> search;
+        std::thread thread;
+        std::atomic <bool> finished {false};
+        std::chrono::steady_clock::time_point started;
+
+        // stop() stops the search, if there is one, and waits for its thread to finish.
+        void stop()
+        {
+            if (!search)    return;
+            search->stop = true;
+            if (thread.joinable())  thread.join();
+        }
+};
+
+// Startup options, set on the command line as name=value before any mode name (i.e. "chess hash=64").
+struct Options
+{
+    // Size of the transposition table in megabytes.
+    int hash_mb = DEFAULT_HASH_MB;
+    // How long the computer opponent thinks about each move, in milliseconds.
+    int movetime = 1000;
+    // If not zero, the most positions the computer opponent searches for each move.
+    int nodes = 0;
+    // Number of threads each search uses.
+    int threads = 1;
+    // If not zero, the computer keeps searching while waiting for its opponent's move.
+    int ponder = 1;
+    // If not zero, saves end with a FEN snapshot of the position, so loading them doesn't replay every move.
+    int snapshot = 1;
+    // If not empty, the opening book the computer plays from before it starts searching.
+    std::string book;
+    // If not empty, the directory of endgame tablebases the search and match adjudication look positions up in.
+    std::string tb;
+} options;
+
+// The book named by the "book" option, and the dice for choosing between its moves.
+OpeningBook opening_book;
+std::mt19937_64 book_random(std::random_device{}());
+
+// The positions "chess bench" searches. They cover an opening, middlegames with many captures, and a rook endgame.
+const char * bench_positions [] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w - - 0 1",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w - - 2 3",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w - - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w - - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"
+};
+
+// run_bench() searches every bench position to the given depth with the given number of threads. It adds the nodes searched
+// to total_nodes and returns the time taken in milliseconds. With verbose set, it prints each position's result.
+int run_bench(int depth, int threads, uint64_t & total_nodes, bool verbose) {
+
+    auto start = std::chrono::steady_clock::now();
+    for (const char * fen : bench_positions)
+    {
+        Board board;
+        board.from_fen(fen);
+        UndoStack history;
+        SearchLimits limits;
+        limits.depth = depth;
+        limits.threads = threads;
+        transposition_table.clear();
+        Search search(board, history, limits);
+        search.report = nullptr;
+        Move best = search.run();
+        if (verbose)
+        {
+            std::cout << fen << "\n\tbest " << move_to_string(best) << "  score " << search.best_score << "  nodes " << search.total_nodes()
+                      << "  pawn hits " << pawn_hit_rate(search) << "%\n";
+        }
+        total_nodes += search.total_nodes();
+    }
+    return std::max((int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count(), 1);
+
+}
+
+// run_check_bench() times the two questions the board's attack maps answer, in the bench positions and every position one move
+// after them: is the side to move in check, and which squares may its king step to. Each is asked rounds times of the maps that
+// make_move() keeps, and of the pieces themselves, working the answer out from scratch. The time make_move() and unmake_move()
+// take, maps included, is printed too, since that is where the cost of keeping them is paid.
+void run_check_bench(int rounds) {
+
+    std::vector <Board> boards;
+    std::unique_ptr <UndoStack> history(new UndoStack());
+    for (const char * fen : bench_positions)
+    {
+        Board board;
+        board.from_fen(fen);
+        boards.push_back(board);
+        MoveList list;
+        generate_legal_moves(board, list);
+        for (Move m : list)
+        {
+            board.make_move(m, *history);
+            boards.push_back(board);
+            board.unmake_move(*history);
+        }
+    }
+
+    // The answers are added up and printed, so the compiler can't leave any of the work out.
+    uint64_t answers [2] = {0, 0};
+    double seconds [3];
+    for (int method = 0 ; method < 3 ; method++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0 ; round < rounds ; round++)
+        {
+            for (Board & board : boards)
+            {
+                int us = board.side_to_move;
+                Bitboard theirs = board.occupied[!us];
+                if (method == 0)
+                {
+                    answers[0] += check_for_check(&board, us == WHITE);
+                    answers[0] += popcount(king_attacks[board.king_square[us]] & ~board.occupied[us] & ~board.attacked[!us]);
+                }
+                else if (method == 1)
+                {
+                    int king = lowest_square(board.pieces[us][KING]);
+                    Bitboard occupancy = board.all_pieces() ^ square_bit(king);
+                    answers[1] += board.is_attacked(king, !us);
+                    for (Bitboard targets = king_attacks[king] & ~board.occupied[us] ; targets ; )
+                    {
+                        answers[1] += !(board.attackers_to(pop_lowest_square(targets), occupancy) & theirs);
+                    }
+                }
+                else
+                {
+                    MoveList list;
+                    generate_legal_moves(board, list);
+                    if (list.size == 0) continue;
+                    board.make_move(list.moves[round % list.size], *history);
+                    board.unmake_move(*history);
+                }
+            }
+        }
+        seconds[method] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double questions = (double)rounds * boards.size();
+    std::cout << boards.size() << " positions, " << rounds << " rounds\n"
+              << "From the attack maps:   " << seconds[0] * 1e9 / questions << " ns per position (" << answers[0] << ")\n"
+              << "Worked out again:       " << seconds[1] * 1e9 / questions << " ns per position (" << answers[1] << ")\n"
+              << "Move generation, make_move() and unmake_move(): " << seconds[2] * 1e9 / questions << " ns per position\n";
+
+}
+
+// bench_command() handles "chess bench ...". Its arguments are one of:
+//     [depth]          search each bench position to a fixed depth (default 7) with the "threads" option, and print the total
+//                      node count, which only changes when the search does, and the speed, which is what to compare between builds
+//     smp [depth]      search the bench positions with 1, 2, 4, 8 and 16 threads, and print each one's time to depth and speedup
+//     check [rounds]   time check detection and king move safety from the attack maps against working them out from scratch
+int bench_command(int argc, char * argv[]) {
+
+    std::vector <std::string> args(argv, argv + argc);
+    bool check = !args.empty() && args[0] == "check";
+    if (check)  args.erase(args.begin());
+    bool smp = !args.empty() && args[0] == "smp";
+    if (smp)    args.erase(args.begin());
+    int depth = 7;
+    try
+    {
+        if (!args.empty())  depth = std::stoi(args[0]);
+    }
+    catch (...)
+    {
+        std::cout << "Usage: chess bench [depth]\n       chess bench smp [depth]\n       chess bench check [rounds]\n";
+        return 1;
+    }
+
+    if (check)
+    {
+        run_check_bench(args.empty() ? 100000 : depth);
+        return 0;
+    }
+
+    if (smp)
+    {
+        int base_ms = 0;
+        for (int threads = 1 ; threads <= 16 ; threads *= 2)
+        {
+            uint64_t total_nodes = 0;
+            int ms = run_bench(depth, threads, total_nodes, false);
+            if (threads == 1)   base_ms = ms;
+            std::cout << "Threads " << threads << ": " << ms << " ms to depth " << depth << ", " << total_nodes << " nodes ("
+                      << total_nodes * 1000 / ms << " nodes/second), speedup " << (double)base_ms / ms << "\n";
+        }
+        return 0;
+    }
+
+    uint64_t total_nodes = 0;
+    int ms = run_bench(depth, options.threads, total_nodes, true);
+    std::cout << "\nNodes: " << total_nodes << "\nTime: " << ms << " ms\nNodes/second: " << total_nodes * 1000 / ms << "\n";
+    return 0;
+
+}
+
+
+// Output in UCI mode comes from both the input thread and the search thread, so whole lines are written under this lock and flushed straight away.
+std::mutex uci_output_lock;
+
+void uci_send(const std::string & line) {
+    std::lock_guard <std::mutex> lock(uci_output_lock);
+    std::cout << line << std::endl;
+}
+
+// uci_report() is the Search report used in UCI mode: one "info" line per completed iteration.
+void uci_report(const Search & search) {
+    int ms = std::max(search.elapsed(), 1);
+    uint64_t nodes = search.total_nodes();
+    std::string line = "info depth " + std::to_string(search.completed_depth) + " score " + score_to_string(search.best_score)
+                     + " nodes " + std::to_string(nodes) + " nps " + std::to_string(nodes * 1000 / ms) + " time " + std::to_string(ms)
+                     + " hashfull " + std::to_string(transposition_table.hashfull()) + " pv";
+    for (int i = 0 ; i < search.pv_length ; i++)    line += " " + move_to_string(search.pv[i]);
+    uci_send(line);
+}
+
+// uci_position() handles "position [startpos | fen <fen>] [moves <move> ...]". It returns false, leaving the start position, if anything is invalid.
+bool uci_position(std::istringstream & command, Board & board, UndoStack & history) {
+
+    board = Board();
+    history.size = 0;
+    std::string word, fen;
+    command >> word;
+    if (word == "fen")
+    {
+        while (command >> word && word != "moves")  fen += word + " ";
+        if (!board.from_fen(fen))   return false;
+    }
+    else if (word != "startpos")    return false;
+    else    command >> word;
+
+    if (word != "moves")    return true;
+    while (command >> word)
+    {
+        Move m;
+        if (parse_move(board, word, m) != MOVE_OK || validate_move(board, m) != MOVE_OK || history.size >= MAX_PLIES - MAX_DEPTH)
+        {
+            board = Board();
+            history.size = 0;
+            return false;
+        }
+        board.make_move(m, history);
+    }
+    return true;
+
+}
+
+// uci_limits() reads the limits of a "go" command. With only a clock, the move gets a thirtieth of the time left plus half the increment.
+SearchLimits uci_limits(std::istringstream & command, int side, bool & infinite) {
+
+    SearchLimits limits;
+    limits.threads = options.threads;
+    int time [2] = {0, 0}, increment [2] = {0, 0}, moves_to_go = 0;
+    std::string word;
+    infinite = false;
+    while (command >> word)
+    {
+        if (word == "infinite")         infinite = true;
+        else if (word == "depth")       command >> limits.depth;
+        else if (word == "nodes")       command >> limits.nodes;
+        else if (word == "movetime")    command >> limits.movetime;
+        else if (word == "wtime")       command >> time[WHITE];
+        else if (word == "btime")       command >> time[BLACK];
+        else if (word == "winc")        command >> increment[WHITE];
+        else if (word == "binc")        command >> increment[BLACK];
+        else if (word == "movestogo")   command >> moves_to_go;
+    }
+    if (time[side] > 0 && limits.movetime == 0)
+    {
+        int share = time[side] / (moves_to_go > 0 ? moves_to_go + 1 : 30) + increment[side] / 2;
+        limits.movetime = std::max(std::min(share, time[side] - 50), 1);
+    }
+    limits.depth = std::min(std::max(limits.depth, 1), MAX_DEPTH - 1);
+    return limits;
+
+}
+
+// uci_command() handles "chess --uci". It reads UCI commands from standard input, one per line, until "quit" or the end of input.
+// Searches run on their own thread, so "stop" and "isready" are answered while one is going.
+int uci_command() {
+
+    Board board;
+    std::unique_ptr <UndoStack> history(new UndoStack());
+    std::unique_ptr <Search> search;
+    std::thread search_thread;
+    // Set by "stop", so an infinite search knows it may send its move.
+    std::atomic <bool> stop_requested {false};
+
+    auto stop_search = [&]()
+    {
+        if (!search)    return;
+        stop_requested = true;
+        search->stop = true;
+        if (search_thread.joinable())   search_thread.join();
+    };
+
+    std::string line;
+    while (std::getline(std::cin, line))
+    {
+        std::istringstream command(line);
+        std::string word;
+        command >> word;
+
+        if (word == "uci")
+        {
+            uci_send("id name TextChess");
+            uci_send("id author Benjamin Knobloch");
+            uci_send("option name Hash type spin default " + std::to_string(DEFAULT_HASH_MB) + " min 1 max 65536");
+            uci_send("option name Threads type spin default 1 min 1 max 256");
+            uci_send("uciok");
+        }
+        else if (word == "isready")     uci_send("readyok");
+        else if (word == "setoption")
+        {
+            // "setoption name <name> value <value>"
+            std::string name, value;
+            command >> word >> name >> word >> value;
+            stop_search();
+            try
+            {
+                if (name == "Hash")     transposition_table.resize(std::max(std::stoi(value), 1));
+                if (name == "Threads")  options.threads = std::min(std::max(std::stoi(value), 1), 256);
+            }
+            catch (...)
+            {
+                uci_send("info string invalid value for " + name);
+            }
+        }
+        else if (word == "ucinewgame")
+        {
+            stop_search();
+            transposition_table.clear();
+        }
+        else if (word == "position")
+        {
+            stop_search();
+            if (!uci_position(command, board, *history))    uci_send("info string invalid position, using the start position");
+        }
+        else if (word == "go")
+        {
+            stop_search();
+            bool infinite;
+            SearchLimits limits = uci_limits(command, board.side_to_move, infinite);
+            Move book_move = opening_book.pick(board, book_random());
+            if (book_move != Move() && !infinite)
+            {
+                uci_send("bestmove " + move_to_string(book_move));
+                continue;
+            }
+            stop_requested = false;
+            search.reset(new Search(board, *history, limits));
+            search->report = uci_report;
+            search_thread = std::thread([&search, &stop_requested, infinite]()
+            {
+                Move best = search->run();
+                // An infinite search may only answer once it has been told to stop.
+                while (infinite && !stop_requested) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                std::string reply = "bestmove " + (best == Move() ? std::string("0000") : move_to_string(best));
+                if (search->pv_length >= 2 && search->pv[0] == best)    reply += " ponder " + move_to_string(search->pv[1]);
+                uci_send(reply);
+            });
+        }
+        else if (word == "stop")        stop_search();
+        else if (word == "quit")        break;
+    }
+    stop_search();
+    return 0;
+
+}
+
+// journal_path() names the journal file of a saved game.
+std::string journal_path(const std::string & id) {
+    return "saved_chess_game_" + id + ".journal";
+}
+
+// save_to_file() writes the side to move and then one "origin destination" line per move in history, with the promotion piece
+// after the destination when there is one. A game that didn't begin from the usual position starts with a "start <fen>" line,
+// and with the snapshot option the file ends with a "fen <fen>" line holding the current position.
+bool save_to_file(const Board & board, const UndoStack & history, const std::string & start_fen, bool whites_turn, std::string id) {
+    try
+    {
+        std::ofstream save_file;
+        save_file.open("saved_chess_game_" + id, std::ios::trunc);
+
+        if (whites_turn)
+        {
+            save_file << "w";
+        } else
+        {
+            save_file << "b";
+        }
+        save_file << "\n";
+        if (!start_fen.empty()) save_file << "start " << start_fen << "\n";
+
+        for (int i = 0 ; i < history.size ; i++)
+        {
+            Move m = history.records[i].move;
+            save_file << integer_to_chess_notation(m.origin()) << " " << integer_to_chess_notation(m.destination());
+            if (m.flag() == PROMOTION)  save_file << "nbrq"[m.promotion() - KNIGHT];
+            save_file << "\n";
+        }
+        if (options.snapshot)   save_file << "fen " << board.to_fen() << "\n";
+
+        save_file.close();
+        
+        return !save_file.fail();
+    }
+    catch (...)
+    {
+        return false;
+    }
+    return false;
+}
+
+// load_from_file() reads a game written by save_to_file() from path. If the save has a FEN snapshot and use_snapshot is set, the board
+// is set up from it directly and history is left empty. Otherwise every move is checked and replayed onto the board and history.
+// It returns false, with a reason in error, if the file is missing or any line is malformed, and the board and history are then
+// back at the start position.
+bool load_from_file(std::string path, bool use_snapshot, Board & board, UndoStack & history, std::string & start_fen, std::string & error) {
+
+    std::ifstream load_file(path);
+    if (!load_file.is_open())
+    {
+        error = "There is no saved game at " + path + ".";
+        return false;
+    }
+
+    std::vector <std::string> lines;
+    std::string line;
+    while (std::getline(load_file, line))
+    {
+        if (!line.empty() && line.back() == '\r')  line.pop_back();
+        lines.push_back(line);
+    }
+
+    board = Board();
+    history.size = 0;
+    start_fen = "";
+    auto fail = [&](size_t number, const std::string & reason)
+    {
+        error = "Line " + std::to_string(number + 1) + " (\"" + lines[number] + "\"): " + reason;
+        board = Board();
+        history.size = 0;
+        start_fen = "";
+        return false;
+    };
+
+    if (lines.empty() || (lines[0] != "w" && lines[0] != "b"))
+    {
+        error = "The first line must be \"w\" or \"b\", for the side to move.";
+        return false;
+    }
+
+    std::string reason;
+    for (size_t i = 1 ; i < lines.size() && use_snapshot ; i++)
+    {
+        if (lines[i].compare(0, 4, "fen ") != 0)    continue;
+        if (!board.from_fen(lines[i].substr(4), &reason))   return fail(i, "the snapshot isn't a valid position, because " + reason + ".");
+        if (lines[0] != (board.side_to_move == WHITE ? "w" : "b"))  return fail(0, "the side to move doesn't match the snapshot.");
+        return true;
+    }
+
+    for (size_t i = 1 ; i < lines.size() ; i++)
+    {
+        if (lines[i].empty() || lines[i].compare(0, 4, "fen ") == 0)   continue;
+        if (lines[i].compare(0, 6, "start ") == 0)
+        {
+            if (i != 1 || !board.from_fen(lines[i].substr(6), &reason))  return fail(i, i != 1 ? "the start position must come first." : "the start position isn't valid, because " + reason + ".");
+            start_fen = lines[i].substr(6);
+            continue;
+        }
+        if (history.size >= MAX_PLIES - MAX_DEPTH)  return fail(i, "the game is too long.");
+
+        Move m;
+        MoveError result = parse_move(board, lines[i], m);
+        if (result == MOVE_OK)  result = validate_move(board, m);
+        // Saves from before promotions were recorded always promoted by asking the player. Queen is by far the likeliest answer.
+        if (result == PROMOTION_REQUIRED)
+        {
+            m = Move(m.origin(), m.destination(), PROMOTION, QUEEN);
+            result = validate_move(board, m);
+        }
+        if (result != MOVE_OK)  return fail(i, move_error_message(result));
+        board.make_move(m, history);
+    }
+    if (lines[0] != (board.side_to_move == WHITE ? "w" : "b"))  return fail(0, "the side to move doesn't match the moves.");
+    return true;
+
+}
+
+// read_saved_game() reads a journal or a text save from path into record, replaying every move even if the save has a snapshot.
+bool read_saved_game(const std::string & path, GameRecord & record, std::string & error) {
+
+    std::unique_ptr <UndoStack> history(new UndoStack());
+    Board board;
+    char magic [4] = {};
+    std::ifstream file(path, std::ios::binary);
+    file.read(magic, 4);
+    file.close();
+
+    record = GameRecord();
+    record.name = path;
+    if (std::string(magic, 4) == "TCJ1")
+    {
+        JournalHeader header;
+        if (!read_journal(path, board, *history, header, error))   return false;
+        record.start_fen = header.start_fen;
+        record.result = header.result;
+    }
+    else if (!load_from_file(path, false, board, *history, record.start_fen, error))  return false;
+
+    for (int i = 0 ; i < history->size ; i++)   record.moves.push_back(history->records[i].move);
+    return true;
+
+}
+
+// journal_command() handles "chess journal test <path>". It saves a game to a journal at path, loads it, plays on in the same
+// journal as a loaded game does, and loads it again. Each load must give back every move played, and the file is removed after.
+int journal_command(int argc, char * argv[]) {
+
+    if (argc < 2 || std::string(argv[0]) != "test")
+    {
+        std::cout << "Usage: chess journal test <path>\n";
+        return 1;
+    }
+    std::string path = argv[1];
+    std::unique_ptr <UndoStack> history(new UndoStack()), loaded(new UndoStack());
+    Board board, start;
+    GameJournal journal;
+    int failures = 0;
+
+    // The moves are picked from the legal ones by ply, so the game is the same every run. One is taken back, as undo does.
+    auto play = [&](int plies)
+    {
+        for (int i = 0 ; i < plies ; i++)
+        {
+            MoveList list;
+            generate_legal_moves(board, list);
+            if (list.size == 0) return;
+            Move m = list.moves[(history->size * 7) % list.size];
+            board.make_move(m, *history);
+            journal.append(m);
+        }
+        board.unmake_move(*history);
+        journal.append_undo();
+    };
+    auto check = [&](const char * stage)
+    {
+        Board read;
+        JournalHeader header;
+        std::string error;
+        bool same = read_journal(path, read, *loaded, header, error) && loaded->size == history->size && header.move_count == (uint32_t)history->size;
+        for (int i = 0 ; same && i < history->size ; i++)   same = loaded->records[i].move == history->records[i].move;
+        std::cout << stage << ": " << history->size << " moves ";
+        if (same)   std::cout << "ok\n";
+        else
+        {
+            std::cout << "FAILED" << (error.empty() ? "" : " (" + error + ")") << "\n";
+            failures++;
+        }
+        return header;
+    };
+
+    play(6);
+    if (!journal.create(path, start, "", *history))
+    {
+        std::cout << "Could not write " << path << "\n";
+        return 1;
+    }
+    play(10);
+    journal.close();
+    JournalHeader header = check("Saved");
+
+    // Play on past a sync, so the header is rewritten in the middle of the reopened file.
+    if (!journal.reopen(path, header))
+    {
+        std::cout << "Could not reopen " << path << "\n";
+        return 1;
+    }
+    play(JOURNAL_SYNC_INTERVAL + 5);
+    journal.close();
+    check("Continued");
+    std::filesystem::remove(path);
+
+    std::cout << failures << " failures\n";
+    return failures == 0 ? 0 : 1;
+
+}
+
+// result_to_string() writes a game result the way PGN does.
+std::string result_to_string(GameResult result) {
+    switch (result)
+    {
+        case WHITE_WINS:    return "1-0";
+        case BLACK_WINS:    return "0-1";
+        case DRAW:          return "1/2-1/2";
+        default:            return "*";
+    }
+}
+
+// db_command() handles "chess db ...". Its arguments are one of:
+//     build <database> <saves...>     gather saved games (journals or text saves) into one database file
+//     query <database> [fen]          list the games that reached a position (default the start position) and what was played next
+int db_command(int argc, char * argv[]) {
+
+    std::vector <std::string> args(argv, argv + argc);
+    if (args.size() >= 3 && args[0] == "build")
+    {
+        std::vector <GameRecord> games;
+        std::string error;
+        for (size_t i = 2 ; i < args.size() ; i++)
+        {
+            GameRecord record;
+            if (!read_saved_game(args[i], record, error))
+            {
+                std::cout << "Skipping " << args[i] << ": " << error << "\n";
+                continue;
+            }
+            games.push_back(std::move(record));
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (!write_game_database(args[1], games, error))
+        {
+            std::cout << "Could not write " << args[1] << ": " << error << "\n";
+            return 1;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        uint64_t positions = 0;
+        for (const GameRecord & game : games)   positions += game.moves.size() + 1;
+        std::cout << "Wrote " << games.size() << " games and " << positions << " positions to " << args[1] << " in " << (int)(seconds * 1000) << " ms\n";
+        return 0;
+    }
+
+    if (args.size() >= 2 && args[0] == "query")
+    {
+        GameDatabase database;
+        std::string error;
+        if (!database.open(args[1], error))
+        {
+            std::cout << "Could not open " << args[1] << ": " << error << "\n";
+            return 1;
+        }
+        std::string fen;
+        for (size_t i = 2 ; i < args.size() ; i++)  fen += args[i] + " ";
+        Board board;
+        if (!fen.empty() && !board.from_fen(fen, &error))
+        {
+            std::cout << "Bad FEN, because " << error << ": " << fen << "\n";
+            return 1;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        auto found = database.find(board.key);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Tally the games and the next moves, most played first. The entries are ordered by game, so a game that came back to
+        // the position is only counted once.
+        uint64_t games = 0;
+        std::vector <std::pair <int, uint16_t>> next_moves;
+        for (const PositionEntry * entry = found.first ; entry != found.second ; entry++)
+        {
+            if (entry == found.first || entry[-1].game != entry->game)  games++;
+            auto same = std::find_if(next_moves.begin(), next_moves.end(), [&](const std::pair <int, uint16_t> & n) {return n.second == entry->next_move;});
+            if (same == next_moves.end())   next_moves.push_back({1, entry->next_move});
+            else    same->first++;
+        }
+        std::sort(next_moves.begin(), next_moves.end(), [](const std::pair <int, uint16_t> & a, const std::pair <int, uint16_t> & b) {return a.first > b.first;});
+        std::cout << games << " of " << database.game_count() << " games reached this position, " << found.second - found.first
+                  << " times in all. The lookup took " << (int)(seconds * 1e6) << " microseconds.\n";
+        for (const auto & n : next_moves)
+        {
+            Move m;
+            m.data = n.second;
+            std::cout << "\t" << (m == Move() ? std::string("(game ended)") : move_to_string(m)) << "\t" << n.first << "\n";
+        }
+
+        const int shown = 20;
+        GameRecord record;
+        for (const PositionEntry * entry = found.first ; entry != found.second && entry - found.first < shown ; entry++)
+        {
+            database.game(entry->game, record);
+            std::cout << "Game " << entry->game + 1 << " (" << record.name << ", " << result_to_string(record.result) << ") at ply " << entry->ply << "\n";
+        }
+        if (found.second - found.first > shown) std::cout << "... and " << found.second - found.first - shown << " more\n";
+        return 0;
+    }
+
+    std::cout << "Usage: chess db build <database> <saves...>\n       chess db query <database> [fen]\n";
+    return 1;
+
+}
+
+// A ReplayJob is one game for "chess replay" to check: a save to read, or a game already read from a PGN file.
+struct ReplayJob
+{
+    uint64_t number;
+    std::string name;
+    bool from_pgn;
+    PgnGame game;
+};
+
+// replay_game() plays one game through the move validator and returns its verdict. legal is set if every move was legal and
+// any recorded result agrees with how the game ends.
+std::string replay_game(const ReplayJob & job, bool & legal) {
+
+    std::unique_ptr <UndoStack> history(new UndoStack());
+    Board board;
+    GameRecord record;
+    std::string error, recorded;
+    legal = false;
+    if (job.from_pgn)
+    {
+        if (!job.game.start_fen.empty() && !board.from_fen(job.game.start_fen, &error))  return "rejected, because the FEN tag isn't a valid position: " + error;
+        recorded = job.game.result.empty() ? "*" : job.game.result;
+    }
+    else
+    {
+        if (!read_saved_game(job.name, record, error))  return "rejected: " + error;
+        if (!record.start_fen.empty())  board.from_fen(record.start_fen);
+        recorded = result_to_string(record.result);
+    }
+
+    size_t plies = job.from_pgn ? job.game.moves.size() : record.moves.size();
+    for (size_t ply = 0 ; ply < plies ; ply++)
+    {
+        if (history->size >= MAX_PLIES - MAX_DEPTH)     return "rejected, because the game is too long";
+        Move m = job.from_pgn ? Move() : record.moves[ply];
+        MoveError result = job.from_pgn ? parse_san(board, job.game.moves[ply], m) : MOVE_OK;
+        if (result == MOVE_OK)  result = apply_move(board, m, *history);
+        if (result != MOVE_OK)
+        {
+            std::string text = job.from_pgn ? job.game.moves[ply] : move_to_string(m);
+            return "illegal move at ply " + std::to_string(ply + 1) + " (" + text + "): " + move_error_message(result);
+        }
+    }
+
+    bool white_moved = board.side_to_move == BLACK;
+    std::string ending, actual;
+    if (check_for_checkmate(board, white_moved))
+    {
+        ending = "checkmate";
+        actual = white_moved ? "1-0" : "0-1";
+    }
+    else if (check_for_stalemate(board, white_moved))
+    {
+        ending = "stalemate";
+        actual = "1/2-1/2";
+    }
+    if (!actual.empty() && recorded != "*" && recorded != actual)   return "legal moves, but recorded as " + recorded + " when it ends in " + ending + ", " + actual;
+
+    legal = true;
+    std::string verdict = "legal, " + std::to_string(plies) + " plies, ";
+    if (!actual.empty())            return verdict + actual + " by " + ending;
+    if (recorded != "*")            return verdict + recorded + " as recorded";
+    if (board.halfmove_clock >= 100)    return verdict + "unfinished, but drawn by the 50-move rule";
+    return verdict + "unfinished";
+
+}
+
+// replay_command() handles "chess replay <files or directories...>". Saves are read whole, as journals or text saves. PGN files
+// (named *.pgn) are streamed a game at a time. Directories are searched for saved_chess_game_* and *.pgn files. The games are
+// shared out to a pool of options.threads workers, and their verdicts are printed in the order the games were read.
+int replay_command(int argc, char * argv[]) {
+
+    std::vector <std::string> paths;
+    for (int i = 0 ; i < argc ; i++)
+    {
+        std::error_code failure;
+        if (!std::filesystem::is_directory(argv[i], failure))
+        {
+            paths.push_back(argv[i]);
+            continue;
+        }
+        std::vector <std::string> found;
+        for (const auto & entry : std::filesystem::directory_iterator(argv[i], failure))
+        {
+            std::string name = entry.path().filename().string();
+            if (name.compare(0, 17, "saved_chess_game_") == 0 || entry.path().extension() == ".pgn")  found.push_back(entry.path().string());
+        }
+        std::sort(found.begin(), found.end());
+        paths.insert(paths.end(), found.begin(), found.end());
+    }
+    if (paths.empty())
+    {
+        std::cout << "Usage: chess replay <saved games, PGN files or directories...>\n";
+        return 1;
+    }
+
+    // The reader waits while the queue is full, so a huge PGN file is never held in memory all at once.
+    const size_t queue_limit = 1024;
+    std::mutex lock;
+    std::condition_variable ready, space;
+    std::deque <ReplayJob> queue;
+    bool reading = true;
+    std::map <uint64_t, std::pair <bool, std::string>> finished;
+    uint64_t printed = 0, legal_games = 0;
+    std::vector <std::string> names;
+
+    auto work = [&]()
+    {
+        while (true)
+        {
+            std::unique_lock <std::mutex> guard(lock);
+            ready.wait(guard, [&] {return !queue.empty() || !reading;});
+            if (queue.empty())  return;
+            ReplayJob job = std::move(queue.front());
+            queue.pop_front();
+            space.notify_one();
+            guard.unlock();
+
+            bool legal;
+            std::string verdict = job.name + ": " + replay_game(job, legal);
+
+            guard.lock();
+            finished[job.number] = {legal, verdict};
+            for (auto next = finished.begin() ; next != finished.end() && next->first == printed ; next = finished.erase(next))
+            {
+                std::cout << next->second.second << "\n";
+                legal_games += next->second.first;
+                printed++;
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    int threads = options.threads;
+    std::vector <std::thread> workers;
+    for (int i = 0 ; i < threads ; i++) workers.emplace_back(work);
+
+    uint64_t games = 0;
+    auto submit = [&](ReplayJob job)
+    {
+        std::unique_lock <std::mutex> guard(lock);
+        space.wait(guard, [&] {return queue.size() < queue_limit;});
+        job.number = games++;
+        queue.push_back(std::move(job));
+        ready.notify_one();
+    };
+    for (const std::string & path : paths)
+    {
+        if (std::filesystem::path(path).extension() != ".pgn")
+        {
+            submit({0, path, false, PgnGame()});
+            continue;
+        }
+        std::ifstream file(path);
+        if (!file.is_open())
+        {
+            submit({0, path, false, PgnGame()});
+            continue;
+        }
+        PgnReader reader(file);
+        PgnGame game;
+        for (int number = 1 ; reader.next(game) ; number++)
+        {
+            submit({0, path + " game " + std::to_string(number) + " (line " + std::to_string(game.line) + ")", true, std::move(game)});
+        }
+    }
+    {
+        std::lock_guard <std::mutex> guard(lock);
+        reading = false;
+    }
+    ready.notify_all();
+    for (std::thread & worker : workers)    worker.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "\n" << games << " games, " << legal_games << " legal and " << games - legal_games << " rejected, in " << (int)(seconds * 1000)
+              << " ms with " << threads << " thread" << (threads == 1 ? "" : "s");
+    if (seconds > 0)    std::cout << " (" << (uint64_t)(games / seconds) << " games/second)";
+    std::cout << "\n";
+    return legal_games == games ? 0 : 1;
+
+}
+
+// An Engine is one side of a match: this program's search with its own settings. It keeps count of the positions it searched
+// and the time it spent, across every game it plays.
+struct Engine
+{
+    std::string name;
+    SearchLimits limits;
+    int hash_mb = DEFAULT_HASH_MB;
+    // Milliseconds on the clock for the whole game, and added after each move. Zero means the engine has no clock.
+    int time = 0;
+    int increment = 0;
+    std::atomic <uint64_t> nodes {0};
+    std::atomic <uint64_t> microseconds {0};
+};
+
+// parse_engine() reads engine settings written as name=value pairs separated by commas (i.e. "nodes=20000,hash=8").
+// The names are depth, nodes, movetime, time, inc and hash. It returns false if a setting is unknown or out of range.
+bool parse_engine(const std::string & spec, Engine & engine) {
+    engine.name = spec;
+    engine.hash_mb = options.hash_mb;
+    std::istringstream settings(spec);
+    std::string setting;
+    try
+    {
+        while (std::getline(settings, setting, ','))
+        {
+            size_t split = setting.find('=');
+            if (split == std::string::npos) return false;
+            std::string name = setting.substr(0, split);
+            int value = std::stoi(setting.substr(split + 1));
+            if (value < (name == "inc" ? 0 : 1))   return false;
+            if (name == "depth")            engine.limits.depth = std::min(value, MAX_DEPTH - 1);
+            else if (name == "nodes")       engine.limits.nodes = value;
+            else if (name == "movetime")    engine.limits.movetime = value;
+            else if (name == "time")        engine.time = value;
+            else if (name == "inc")         engine.increment = value;
+            else if (name == "hash")        engine.hash_mb = value;
+            else    return false;
+        }
+    }
+    catch (...)
+    {
+        return false;
+    }
+    // Without any limit the engine would think forever, so it gets the usual time per move.
+    if (engine.limits.depth == MAX_DEPTH && !engine.limits.nodes && !engine.limits.movetime && !engine.time)  engine.limits.movetime = options.movetime;
+    return true;
+}
+
+// adjudicate() decides whether the game on board is over, and if so returns its result and sets reason to why.
+GameResult adjudicate(const Board & board, const UndoStack & history, std::string & reason) {
+
+    bool white_moved = board.side_to_move == BLACK;
+    if (check_for_checkmate(board, white_moved))
+    {
+        reason = "checkmate";
+        return white_moved ? WHITE_WINS : BLACK_WINS;
+    }
+    int wdl, dtm;
+    if (check_for_stalemate(board, white_moved))    reason = "stalemate";
+    else if (board.halfmove_clock >= 100)           reason = "the 50-move rule";
+    else if (tablebases.probe(board, wdl, dtm))
+    {
+        // With perfect play the tablebase already knows the result, so there is no need to play it out.
+        reason = "the tablebase";
+        if (wdl != 0)   return (wdl > 0) == white_moved ? BLACK_WINS : WHITE_WINS;
+    }
+    else if (history.size >= MAX_PLIES - MAX_DEPTH) reason = "the game running too long";
+    else
+    {
+        // Only positions since the last capture or pawn move, with the same side to move, can be repeats.
+        int repeats = 0;
+        int oldest = std::max(history.size - board.halfmove_clock, 0);
+        for (int i = history.size - 2 ; i >= oldest ; i -= 2)  repeats += history.records[i].key == board.key;
+        if (repeats < 2)    return RESULT_NONE;
+        reason = "threefold repetition";
+    }
+    return DRAW;
+
+}
+
+// play_match_game() plays one game from start between two engines, each searching with its own transposition table,
+// and leaves the moves on history. Both engines play from the opening book while they can, choosing with random.
+// It returns the result, and sets reason to why the game ended.
+GameResult play_match_game(Board & board, UndoStack & history, Engine * engines [2], TranspositionTable * tables [2], std::mt19937_64 & random, std::string & reason) {
+
+    int clock [2] = {engines[WHITE]->time, engines[BLACK]->time};
+    tables[WHITE]->clear();
+    tables[BLACK]->clear();
+    while (true)
+    {
+        GameResult result = adjudicate(board, history, reason);
+        if (result != RESULT_NONE)  return result;
+
+        int side = board.side_to_move;
+        Move book_move = opening_book.pick(board, random());
+        if (book_move != Move())
+        {
+            apply_move(board, book_move, history);
+            continue;
+        }
+
+        Engine & engine = *engines[side];
+        SearchLimits limits = engine.limits;
+        // With a clock, each move gets a share of the time left, as in UCI mode.
+        if (engine.time && !limits.movetime)    limits.movetime = std::max(std::min(clock[side] / 30 + engine.increment / 2, clock[side] - 50), 1);
+
+        std::unique_ptr <Search> search(new Search(board, history, limits));
+        search->table = tables[side];
+        auto start = std::chrono::steady_clock::now();
+        Move m = search->run();
+        int64_t spent = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        engine.nodes += search->total_nodes();
+        engine.microseconds += spent;
+
+        if (engine.time)
+        {
+            clock[side] -= spent / 1000;
+            if (clock[side] < 0)
+            {
+                reason = "time forfeit";
+                return side == WHITE ? BLACK_WINS : WHITE_WINS;
+            }
+            clock[side] += engine.increment;
+        }
+        if (apply_move(board, m, history) != MOVE_OK)
+        {
+            reason = "an illegal move";
+            return side == WHITE ? BLACK_WINS : WHITE_WINS;
+        }
+    }
+
+}
+
+// elo_difference() turns a score fraction into the Elo difference it implies.
+double elo_difference(double score) {
+    return -400 * std::log10(1 / score - 1);
+}
+
+// match_command() handles "chess match <games> <engine A> <engine B> [openings <file>] [pgn <file>] [journals <directory>]".
+// Games are played options.threads at a time, one per thread. Each opening is played twice, once with each engine as white.
+// Openings are FEN lines, with anything after a ";" ignored so EPD files work too. Without them, every game starts normally.
+int match_command(int argc, char * argv[]) {
+
+    std::vector <std::string> args(argv, argv + argc);
+    Engine engines [2];
+    int games = 0;
+    std::string openings_path, pgn_path, journal_directory;
+    bool usable = args.size() >= 3 && args.size() % 2 == 1;
+    try
+    {
+        if (usable) games = std::stoi(args[0]);
+    }
+    catch (...)
+    {
+        usable = false;
+    }
+    for (size_t i = 3 ; usable && i < args.size() ; i += 2)
+    {
+        if (args[i] == "openings")      openings_path = args[i + 1];
+        else if (args[i] == "pgn")      pgn_path = args[i + 1];
+        else if (args[i] == "journals") journal_directory = args[i + 1];
+        else    usable = false;
+    }
+    if (!usable || games < 1 || !parse_engine(args[1], engines[0]) || !parse_engine(args[2], engines[1]))
+    {
+        std::cout << "Usage: chess match <games> <engine A> <engine B> [openings <file>] [pgn <file>] [journals <directory>]\n"
+                  << "Engines are settings like \"nodes=20000\" or \"time=10000,inc=100,hash=8\" (depth, nodes, movetime, time, inc, hash).\n";
+        return 1;
+    }
+
+    std::vector <std::string> openings;
+    if (!openings_path.empty())
+    {
+        std::ifstream file(openings_path);
+        if (!file.is_open())
+        {
+            std::cout << "Could not open " << openings_path << "\n";
+            return 1;
+        }
+        std::string line, error;
+        for (int number = 1 ; std::getline(file, line) ; number++)
+        {
+            std::string fen = line.substr(0, line.find(';'));
+            if (fen.find_first_not_of(" \t\r") == std::string::npos || fen[0] == '#')    continue;
+            Board board;
+            if (!board.from_fen(fen, &error))
+            {
+                std::cout << "Line " << number << " of " << openings_path << " isn't a valid position, because " << error << ".\n";
+                return 1;
+            }
+            openings.push_back(board.to_fen());
+        }
+    }
+    if (openings.empty())   openings.push_back("");
+
+    std::ofstream pgn;
+    if (!pgn_path.empty())
+    {
+        pgn.open(pgn_path, std::ios::trunc);
+        if (!pgn.is_open())
+        {
+            std::cout << "Could not open " << pgn_path << "\n";
+            return 1;
+        }
+    }
+
+    std::mutex lock;
+    std::atomic <int> next_game {0};
+    int wins = 0, losses = 0, draws = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    auto work = [&]()
+    {
+        std::unique_ptr <TranspositionTable> tables [2] = {std::unique_ptr <TranspositionTable> (new TranspositionTable()), std::unique_ptr <TranspositionTable> (new TranspositionTable())};
+        tables[0]->resize(engines[0].hash_mb);
+        tables[1]->resize(engines[1].hash_mb);
+        std::unique_ptr <UndoStack> history(new UndoStack());
+        for (int game = next_game++ ; game < games ; game = next_game++)
+        {
+            // Engine A is white in even games and black in odd ones, with each opening played once each way.
+            const std::string & opening = openings[(game / 2) % openings.size()];
+            int a_color = game % 2 == 0 ? WHITE : BLACK;
+            Engine * players [2];
+            TranspositionTable * player_tables [2];
+            players[a_color] = &engines[0];
+            players[!a_color] = &engines[1];
+            player_tables[a_color] = tables[0].get();
+            player_tables[!a_color] = tables[1].get();
+
+            Board board, start_board;
+            if (!opening.empty())   start_board.from_fen(opening);
+            board = start_board;
+            history->size = 0;
+            std::string reason;
+            // Both games of a pair roll the same dice, so they follow the same book line with the colors reversed.
+            std::mt19937_64 random(game / 2);
+            GameResult result = play_match_game(board, *history, players, player_tables, random, reason);
+
+            PgnGame record;
+            record.start_fen = opening;
+            record.result = result_to_string(result);
+            record.tags = {{"Event", "chess match"}, {"Round", std::to_string(game + 1)}, {"White", players[WHITE]->name}, {"Black", players[BLACK]->name}, {"Termination", reason}};
+            if (pgn.is_open())
+            {
+                Board replay = start_board;
+                std::unique_ptr <UndoStack> moves(new UndoStack());
+                for (int i = 0 ; i < history->size ; i++)
+                {
+                    Move m = history->records[i].move;
+                    record.moves.push_back(move_to_san(replay, m, *moves));
+                    replay.make_move(m, *moves);
+                }
+            }
+
+            std::lock_guard <std::mutex> guard(lock);
+            if (result == DRAW)                                     draws++;
+            else if ((result == WHITE_WINS) == (a_color == WHITE))  wins++;
+            else                                                    losses++;
+            std::cout << "Game " << game + 1 << ": " << players[WHITE]->name << " vs " << players[BLACK]->name << ", " << record.result
+                      << " by " << reason << " after " << history->size << " plies\n";
+            if (pgn.is_open())  write_pgn_game(pgn, record);
+            if (!journal_directory.empty())
+            {
+                GameJournal journal;
+                std::string path = journal_directory + "/saved_chess_game_match_" + std::to_string(game + 1) + ".journal";
+                if (!journal.create(path, start_board, opening, *history) || !journal.finish(result))   std::cout << "Could not write " << path << "\n";
+            }
+        }
+    };
+
+    std::vector <std::thread> workers;
+    for (int i = 0 ; i < std::min(options.threads, games) ; i++)    workers.emplace_back(work);
+    for (std::thread & worker : workers)    worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // The error margin is a 95% confidence interval, from the spread of the per-game scores.
+    int played = wins + losses + draws;
+    double score = (wins + 0.5 * draws) / played;
+    double variance = (wins * (1 - score) * (1 - score) + losses * score * score + draws * (0.5 - score) * (0.5 - score)) / played;
+    double margin = 1.96 * std::sqrt(variance / played);
+    std::cout << "\n" << engines[0].name << " vs " << engines[1].name << ": " << wins << " wins, " << losses << " losses, " << draws
+              << " draws (" << (int)(score * 1000) / 10.0 << "%) in " << (int)seconds << " s\n";
+    if (score > 0 && score < 1)
+    {
+        double low = elo_difference(std::max(score - margin, 0.001));
+        double high = elo_difference(std::min(score + margin, 0.999));
+        std::cout << "Elo difference: " << std::showpos << (int)std::lround(elo_difference(score)) << std::noshowpos
+                  << " +/- " << (int)std::lround((high - low) / 2) << "\n";
+    }
+    else    std::cout << "Elo difference: " << (score > 0 ? "+" : "-") << "infinite, as one engine won every game\n";
+    for (const Engine & engine : engines)
+    {
+        double thought = engine.microseconds / 1e6;
+        std::cout << engine.name << ": " << engine.nodes << " nodes";
+        if (thought > 0)    std::cout << " (" << (uint64_t)(engine.nodes / thought) << " nodes/second)";
+        std::cout << "\n";
+    }
+    return 0;
+
+}
+
+// book_command() handles "chess book ...". Its arguments are one of:
+//     build <book> <plies> <games...>     make a book from the first moves of saved games and PGN files
+//     probe <book> [fen]                  list the book moves for a position (default the start position)
+//     test                                check the Polyglot keys against the ones published with the format
+// A move's weight counts 2 for each game its side went on to win and 1 for each draw or game without a result.
+int book_command(int argc, char * argv[]) {
+
+    std::vector <std::string> args(argv, argv + argc);
+    int plies = 0;
+    try
+    {
+        if (args.size() >= 4 && args[0] == "build") plies = std::stoi(args[2]);
+    }
+    catch (...)
+    {
+        plies = 0;
+    }
+    if (plies > 0)
+    {
+        std::map <std::pair <uint64_t, uint16_t>, uint64_t> weights;
+        std::unique_ptr <UndoStack> history(new UndoStack());
+        uint64_t games = 0;
+        auto add_game = [&](const std::string & start_fen, const std::string & result, const std::vector <std::string> * san, const std::vector <Move> * moves)
+        {
+            Board board;
+            if (!start_fen.empty() && !board.from_fen(start_fen))   return;
+            history->size = 0;
+            games++;
+            size_t length = san ? san->size() : moves->size();
+            for (size_t ply = 0 ; ply < length && (int)ply < plies ; ply++)
+            {
+                Move m = moves ? (*moves)[ply] : Move();
+                // PGN games stop counting at the first move this program can't play, such as castling.
+                if (san && parse_san(board, (*san)[ply], m) != MOVE_OK)    break;
+                bool white = board.side_to_move == WHITE;
+                uint64_t key = book_key(board);
+                int weight = 1;
+                if (result == "1-0")        weight = white ? 2 : 0;
+                else if (result == "0-1")   weight = white ? 0 : 2;
+                if (apply_move(board, m, *history) != MOVE_OK)  break;
+                weights[{key, m.data}] += weight;
+            }
+        };
+        for (size_t i = 3 ; i < args.size() ; i++)
+        {
+            std::string error;
+            if (std::filesystem::path(args[i]).extension() == ".pgn")
+            {
+                std::ifstream file(args[i]);
+                if (!file.is_open())
+                {
+                    std::cout << "Skipping " << args[i] << ": it can't be opened\n";
+                    continue;
+                }
+                PgnReader reader(file);
+                PgnGame game;
+                while (reader.next(game))   add_game(game.start_fen, game.result, &game.moves, nullptr);
+                continue;
+            }
+            GameRecord record;
+            if (read_saved_game(args[i], record, error))    add_game(record.start_fen, result_to_string(record.result), nullptr, &record.moves);
+            else    std::cout << "Skipping " << args[i] << ": " << error << "\n";
+        }
+
+        // Weights are scaled down if any is too big for the 16 bits a book entry has, keeping every move that won or drew.
+        uint64_t heaviest = 1;
+        for (const auto & w : weights)  heaviest = std::max(heaviest, w.second);
+        std::vector <BookEntry> entries;
+        for (const auto & w : weights)
+        {
+            if (w.second == 0)  continue;
+            Move m;
+            m.data = w.first.second;
+            uint64_t weight = heaviest > 0xFFFF ? std::max<uint64_t>(w.second * 0xFFFF / heaviest, 1) : w.second;
+            entries.push_back({w.first.first, m, (uint16_t)weight});
+        }
+        std::string error;
+        if (!write_opening_book(args[1], entries, error))
+        {
+            std::cout << "Could not write " << args[1] << ": " << error << "\n";
+            return 1;
+        }
+        std::cout << "Wrote " << entries.size() << " moves from " << games << " games to " << args[1] << "\n";
+        return 0;
+    }
+
+    if (args.size() >= 2 && args[0] == "probe")
+    {
+        OpeningBook book;
+        std::string error;
+        if (!book.open(args[1], error))
+        {
+            std::cout << "Could not open " << args[1] << ": " << error << "\n";
+            return 1;
+        }
+        std::string fen;
+        for (size_t i = 2 ; i < args.size() ; i++)  fen += args[i] + " ";
+        Board board;
+        if (!fen.empty() && !board.from_fen(fen, &error))
+        {
+            std::cout << "Bad FEN, because " << error << ": " << fen << "\n";
+            return 1;
+        }
+
+        Move moves [MAX_MOVES];
+        int weights [MAX_MOVES], total = 0;
+        auto start = std::chrono::steady_clock::now();
+        int count = book.probe(board, moves, weights, MAX_MOVES);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        for (int i = 0 ; i < count ; i++)   total += weights[i];
+        std::cout << count << " book moves among " << book.size_in_entries() << " entries. The probe took " << (int)(seconds * 1e6) << " microseconds.\n";
+        for (int i = 0 ; i < count ; i++)
+        {
+            std::cout << "\t" << move_to_string(moves[i]) << "\t" << weights[i];
+            if (total > 0)  std::cout << "\t(" << 100 * weights[i] / total << "%)";
+            std::cout << "\n";
+        }
+        return 0;
+    }
+
+    if (args.size() == 1 && args[0] == "test")
+    {
+        // The published keys count castling rights, which this program doesn't keep, so the entries for the rights each position
+        // still has (K, Q, k and q at 768 to 771) are added here.
+        struct
+        {
+            const char * moves;
+            const char * castling;
+            uint64_t key;
+        } const published [] =
+        {
+            {"",                                    "KQkq", 0x463B96181691FC9CULL},
+            {"e2e4",                                "KQkq", 0x823C9B50FD114196ULL},
+            {"e2e4 d7d5",                           "KQkq", 0x0756B94461C50FB0ULL},
+            {"e2e4 d7d5 e4e5",                      "KQkq", 0x662FAFB965DB29D4ULL},
+            {"e2e4 d7d5 e4e5 f7f5",                 "KQkq", 0x22A48B5A8E47FF78ULL},
+            {"e2e4 d7d5 e4e5 f7f5 e1e2",            "kq",   0x652A607CA3F242C1ULL},
+            {"e2e4 d7d5 e4e5 f7f5 e1e2 e8f7",       "",     0x00FDD303C946BDD9ULL},
+            {"a2a4 b7b5 h2h4 b5b4 c2c4",            "KQkq", 0x3C8123EA7B067637ULL},
+            {"a2a4 b7b5 h2h4 b5b4 c2c4 b4c3",       "KQkq", 0x93D32682782EDFAEULL},
+            {"a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3",  "Kkq",  0x5C3F9B829B279560ULL},
+        };
+        std::unique_ptr <UndoStack> history(new UndoStack());
+        int failures = 0;
+        for (const auto & p : published)
+        {
+            Board board;
+            std::istringstream command(std::string("startpos moves ") + p.moves);
+            uint64_t key = 0;
+            if (uci_position(command, board, *history))
+            {
+                key = polyglot_key(board);
+                for (const char * c = p.castling ; *c ; c++)    key ^= polyglot_random[768 + std::string("KQkq").find(*c)];
+            }
+            std::cout << (*p.moves ? p.moves : "start position") << ": " << std::hex << key;
+            if (key == p.key)   std::cout << " ok\n";
+            else
+            {
+                std::cout << " FAILED, expected " << p.key << "\n";
+                failures++;
+            }
+            std::cout << std::dec;
+        }
+        std::cout << failures << " failures\n";
+        return failures ? 1 : 0;
+    }
+
+    std::cout << "Usage: chess book build <book> <plies> <saved games or PGN files...>\n       chess book probe <book> [fen]\n       chess book test\n";
+    return 1;
+
+}
+
+// tablebase_value() describes a tablebase result for the side to move (i.e. "wins, mate in 7 plies").
+std::string tablebase_value(int wdl, int dtm) {
+
+    if (wdl == 0)   return "draws";
+    return std::string(wdl > 0 ? "wins" : "loses") + ", mate in " + std::to_string(dtm) + " plies";
+
+}
+
+// tb_command() handles "chess tb ...". Its arguments are one of:
+//     generate <directory> <pieces...>    make the tables for each set of pieces (i.e. "KRvKP"), or for every set of a number of pieces (i.e. "4")
+//     probe <directory> <fen>             look a position up in the tables in directory, and show the best move
+int tb_command(int argc, char * argv[]) {
+
+    std::vector <std::string> args(argv, argv + argc);
+    if (args.size() >= 3 && args[0] == "generate")
+    {
+        // A number stands for every set of that many pieces: two kings and any choice of the others.
+        std::vector <std::string> materials;
+        for (size_t i = 2 ; i < args.size() ; i++)
+        {
+            if (args[i].size() != 1 || args[i][0] < '2' || args[i][0] > '0' + TABLEBASE_MAX_PIECES)
+            {
+                materials.push_back(args[i]);
+                continue;
+            }
+            const std::string letters = "QRBNPqrbnp";
+            std::function <void(std::string, size_t, int)> choose = [&](std::string chosen, size_t from, int left)
+            {
+                if (left == 0)
+                {
+                    std::string white, black;
+                    for (char c : chosen)   (std::isupper(c) ? white : black) += std::toupper(c);
+                    materials.push_back("K" + white + "vK" + black);
+                    return;
+                }
+                for (size_t l = from ; l < letters.size() ; l++)    choose(chosen + letters[l], l, left - 1);
+            };
+            choose("", 0, args[i][0] - '2');
+        }
+
+        for (const std::string & material : materials)
+        {
+            std::vector <TablebaseReport> reports;
+            std::string error;
+            bool made = tablebases.generate(material, args[1], options.threads, reports, error);
+            for (const TablebaseReport & r : reports)
+            {
+                std::cout << r.name << ": " << r.positions << " positions, " << r.wins << " won, " << r.draws << " drawn, " << r.losses << " lost for the side to move. "
+                          << "Longest mate " << r.longest << " plies. " << (int)(r.seconds * 1000) << " ms, " << r.working_bytes / 1024 << " KB while working, "
+                          << r.table_bytes / 1024 << " KB on disk.\n";
+            }
+            if (!made)
+            {
+                std::cout << "Could not make " << material << ": " << error << "\n";
+                return 1;
+            }
+        }
+        std::cout << tablebases.size() << " tables in " << args[1] << "\n";
+        return 0;
+    }
+
+    if (args.size() >= 3 && args[0] == "probe")
+    {
+        std::string error;
+        if (!tablebases.load(args[1], error))
+        {
+            std::cout << "Could not load the tablebases in " << args[1] << ": " << error << "\n";
+            return 1;
+        }
+        std::string fen;
+        for (size_t i = 2 ; i < args.size() ; i++)  fen += args[i] + " ";
+        Board board;
+        if (!board.from_fen(fen, &error))
+        {
+            std::cout << "Bad FEN, because " << error << ": " << fen << "\n";
+            return 1;
+        }
+
+        int wdl, dtm;
+        auto start = std::chrono::steady_clock::now();
+        bool found = tablebases.probe(board, wdl, dtm);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!found)
+        {
+            std::cout << "The position isn't in the tablebases.\n";
+            return 1;
+        }
+        std::cout << (board.side_to_move == WHITE ? "White" : "Black") << " " << tablebase_value(wdl, dtm) << ". The probe took " << (int)(seconds * 1e6) << " microseconds.\n";
+
+        // The best move wins soonest, loses latest, or keeps the draw. Replies with en passant rights aren't in the tables, so they are skipped.
+        std::unique_ptr <UndoStack> history(new UndoStack());
+        MoveList list;
+        generate_legal_moves(board, list);
+        Move best;
+        int best_score = -INFINITE_SCORE;
+        for (Move m : list)
+        {
+            board.make_move(m, *history);
+            int reply_wdl, reply_dtm;
+            if (tablebases.probe(board, reply_wdl, reply_dtm))
+            {
+                int score = reply_wdl == 0 ? 0 : -reply_wdl * (MATE_SCORE - reply_dtm);
+                if (score > best_score)
+                {
+                    best_score = score;
+                    best = m;
+                }
+            }
+            board.unmake_move(*history);
+        }
+        if (best != Move()) std::cout << "Best move: " << move_to_string(best) << "\n";
+        return 0;
+    }
+
+    std::cout << "Usage: chess tb generate <directory> <pieces or piece counts...>\n       chess tb probe <directory> <fen>\n";
+    return 1;
+
+}
+
+// parse_option() applies one name=value startup option. It returns false if the option is unknown or its value is out of range.
+bool parse_option(std::string option) {
+    size_t split = option.find('=');
+    std::string name = option.substr(0, split);
+    if (name == "book")
+    {
+        options.book = option.substr(split + 1);
+        return true;
+    }
+    if (name == "tb")
+    {
+        options.tb = option.substr(split + 1);
+        return true;
+    }
+    try
+    {
+        int value = std::stoi(option.substr(split + 1));
+        if (name == "hash" && value >= 1)
+        {
+            options.hash_mb = value;
+            return true;
+        }
+        if (name == "movetime" && value >= 1)
+        {
+            options.movetime = value;
+            return true;
+        }
+        if (name == "nodes" && value >= 0)
+        {
+            options.nodes = value;
+            return true;
+        }
+        if (name == "threads" && value >= 1 && value <= 256)
+        {
+            options.threads = value;
+            return true;
+        }
+        if (name == "ponder" && (value == 0 || value == 1))
+        {
+            options.ponder = value;
+            return true;
+        }
+        if (name == "snapshot" && (value == 0 || value == 1))
+        {
+            options.snapshot = value;
+            return true;
+        }
+    }
+    catch (...)
+    {
+        return false;
+    }
+    return false;
+}
+
+// Main program loop allows players to create a board and play a game.
+// Run as "chess perft ..." to benchmark and check the move generator, "chess bench ..." to benchmark the search,
+// "chess db ..." to build or search a game database, "chess replay ..." to check saved games, "chess match ..." to play the
+// engine against itself, "chess book ..." to build or look into an opening book, "chess tb ..." to make or look into endgame
+// tablebases, or "chess --uci" to be driven by another program, instead.
+int main(int argc, char * argv[]) {
+
+    int arg = 1;
+    for ( ; arg < argc && std::string(argv[arg]).find('=') != std::string::npos ; arg++)
+    {
+        if (!parse_option(argv[arg]))
+        {
+            std::cout << "Unknown or invalid option: " << argv[arg] << "\n";
+            return 1;
+        }
+    }
+    transposition_table.resize(options.hash_mb);
+    std::string book_error;
+    if (!options.book.empty() && !opening_book.open(options.book, book_error))
+    {
+        std::cout << "Could not open the opening book " << options.book << ": " << book_error << "\n";
+        return 1;
+    }
+    std::string tb_error;
+    if (!options.tb.empty() && !tablebases.load(options.tb, tb_error))
+    {
+        std::cout << "Could not load the tablebases in " << options.tb << ": " << tb_error << "\n";
+        return 1;
+    }
+
+    if (arg < argc && std::string(argv[arg]) == "perft")   return perft_command(argc - arg - 1, argv + arg + 1);
+    if (arg < argc && std::string(argv[arg]) == "bench")   return bench_command(argc - arg - 1, argv + arg + 1);
+    if (arg < argc && std::string(argv[arg]) == "db")      return db_command(argc - arg - 1, argv + arg + 1);
+    if (arg < argc && std::string(argv[arg]) == "replay")  return replay_command(argc - arg - 1, argv + arg + 1);
+    if (arg < argc && std::string(argv[arg]) == "journal") return journal_command(argc - arg - 1, argv + arg + 1);
+    if (arg < argc && std::string(argv[arg]) == "match")   return match_command(argc - arg - 1, argv + arg + 1);
+    if (arg < argc && std::string(argv[arg]) == "book")    return book_command(argc - arg - 1, argv + arg + 1);
+    if (arg < argc && std::string(argv[arg]) == "tb")      return tb_command(argc - arg - 1, argv + arg + 1);
+    if (arg < argc && std::string(argv[arg]) == "--uci")   return uci_command();
+
+    bool game_in_progress = true;
+
+    std::cout << "\n\n\n\t\t\tHello! Welcome to Benjamin Knobloch's C++ Chess Program.\n\n\n";
+
+    bool need_start_response = true;
+    Board my_board;
+    // Every move played so far. It doubles as the move list for viewing and saving the game.
+    UndoStack history;
+    bool whites_turn;
+    // The color the computer plays, or -1 in a game between two players.
+    int computer_color = -1;
+    Ponder ponder;
+    // The FEN of the position the game began from, or empty for the usual starting position.
+    std::string start_fen;
+    // Once the game has been saved, every move is appended to its journal as it is played.
+    GameJournal journal;
+
+    std::string start_response = "";
+    while (need_start_response)
+    {
+        std::cout << "\n\n\t\t\tWould you like to start a new game? (Y)es, (C)omputer opponent, (P)osition from FEN, (L)oad existing game, or (N)o: ";
+        std::cin >> start_response;
+
+        if (start_response == "l" || start_response == "L")
+        {
+            std::string saved_id;
+            std::cout << "\n\n\t\t\tType the ID of a saved game to load it: ";
+            std::cin >> saved_id;
+
+            std::string error;
+            JournalHeader header;
+            std::ifstream journal_file(journal_path(saved_id));
+            if (journal_file.is_open())
+            {
+                // A game saved since journals were added is read from its journal, and carries on appending to it.
+                journal_file.close();
+                if (read_journal(journal_path(saved_id), my_board, history, header, error) && journal.reopen(journal_path(saved_id), header))
+                {
+                    start_fen = header.start_fen;
+                    std::cout << "\n\t\t\tSaved game successfully loaded.";
+                    if (header.result != RESULT_NONE)
+                    {
+                        std::cout << " That game is already over. Here is its final position.";
+                        game_in_progress = false;
+                    }
+                    whites_turn = my_board.side_to_move == WHITE;
+                    need_start_response = false;
+                }
+                else
+                {
+                    std::cout << "\n\t\t\tError loading saved game. The journal is damaged: " << error << ".";
+                    my_board = Board();
+                    history.size = 0;
+                }
+            }
+            else if (!load_from_file("saved_chess_game_" + saved_id, true, my_board, history, start_fen, error))
+            {
+                std::cout << "\n\t\t\tError loading saved game. " << error;
+            }
+            else
+            {
+                std::cout << "\n\t\t\tSaved game successfully loaded.";
+                if (history.empty() && my_board.key != Board().key)    std::cout << " It was resumed from a snapshot, so moves made before the save can't be undone.";
+                whites_turn = my_board.side_to_move == WHITE;
+                need_start_response = false;
+            }
+
+        }
+        if (start_response == "p" || start_response == "P")
+        {
+            std::string fen, error;
+            std::cout << "\n\n\t\t\tType the position as a FEN string: ";
+            std::getline(std::cin >> std::ws, fen);
+            if (!my_board.from_fen(fen, &error))
+            {
+                std::cout << "\n\t\t\tThat isn't a valid position, because " << error << ".";
+            }
+            else
+            {
+                start_fen = fen;
+                std::cout << "\n\n\t\t\tIf you wish to save your game at any point, type \"S\" instead of a move.";
+                whites_turn = my_board.side_to_move == WHITE;
+                need_start_response = false;
+            }
+        }
+        if (start_response == "n" || start_response == "N")
+        {
+            std::cout << "\n\n\t\t\tOkay. Have a good day!";
+            game_in_progress = false;
+            need_start_response = false;
+        }
+        if (start_response == "c" || start_response == "C")
+        {
+            std::string color = "";
+            while (color != "w" && color != "W" && color != "b" && color != "B")
+            {
+                std::cout << "\n\n\t\t\tWould you like to play (W)hite or (B)lack?: ";
+                std::cin >> color;
+            }
+            if (color == "w" || color == "W")   computer_color = BLACK;
+            else                                computer_color = WHITE;
+            start_response = "y";
+        }
+        if (start_response == "y" || start_response == "Y")
+        {
+            std::cout << "\n\n\t\t\tIf you wish to save your game at any point, type \"S\" instead of a move.";
+            whites_turn = true;
+            need_start_response = false;
+        }
+    }
+
+    
+
+    std::cout << "\n\n";
+    render(my_board);
+    
+    while (game_in_progress)
+    {
+
+        std::cout << "\n\t====================\n";
+
+        if (whites_turn)    std::cout << "\n\tIt is white's turn. (uppercase characters)";
+        else                std::cout << "\n\tIt is black's turn. (lowercase characters)";
+
+        bool looking_for_valid_move = true;
+
+        std::string o, d;
+        if (computer_color == (whites_turn ? WHITE : BLACK))
+        {
+            std::cout << "\n\tThe computer is thinking...";
+            SearchLimits limits;
+            limits.movetime = options.movetime;
+            limits.nodes = options.nodes;
+            limits.threads = options.threads;
+            Search search(my_board, history, limits);
+            search.report = print_iteration;
+            Move m = opening_book.pick(my_board, book_random()), expected;
+            if (m != Move())
+            {
+                ponder.cancel();
+                std::cout << "\n\tThe computer played a move from its opening book.";
+            }
+            // A move from pondering is checked again before it is played, in case it was searched in another position.
+            else if (history.empty() || !ponder.finish(my_board, history.top().move, options.movetime, m, expected) || validate_move(my_board, m) != MOVE_OK)
+            {
+                m = search.run();
+                expected = search.pv_length >= 2 ? search.pv[1] : Move();
+            }
+            my_board.make_move(m, history);
+            journal.append(m);
+            // The second move of the principal variation is the reply the computer expects, so it thinks about that while it waits.
+            if (options.ponder && expected != Move())   ponder.start(my_board, history, expected, options.threads);
+            std::cout << "\n\n\tThe computer moved from " << integer_to_chess_notation(m.origin()) << " to " << integer_to_chess_notation(m.destination());
+            if (m.flag() == PROMOTION)  std::cout << " and promoted to a " << std::string("pawn  knightbishoprook  queen ").substr(6 * m.promotion(), 6);
+            std::cout << ".\n";
+            looking_for_valid_move = false;
+        }
+        // The legal moves are worked out once per turn. Every move typed is then checked against them, and (M)oves reads them too.
+        LegalMoves legal;
+        if (looking_for_valid_move) legal.compute(my_board);
+        while (looking_for_valid_move)
+        {
+
+            std::cout << "\n\tWhat piece would you like to move? Or would you like to (U)ndo, (V)iew move list, see the (M)oves of a piece, show the (F)EN, see the (B)ook moves, (S)ave, or (E)xport this game as text?: ";
+            std::cin >> o;
+
+            if (o == "s" || o == "S" || o == "e" || o == "E")
+            {             // Save game, or export it as text.
+                std::string save_id;
+                std::cout << "\n\nPlease give your saved game a string ID. When you want to load this game, use the ID to do so: ";
+                std::cin >> save_id;
+                while (save_id == "")
+                {
+                    std::cout << "\nPlease enter an ID: ";
+                    std::cin >> save_id;
+                }
+                Board start;
+                if (!start_fen.empty()) start.from_fen(start_fen);
+                if (o == "e" || o == "E")
+                {
+                    if (save_to_file(my_board, history, start_fen, whites_turn, save_id))   std::cout << "\n\n\t\t\tExport successful.";
+                    else                                                                    std::cout << "\n\n\t\t\tExport failed. Please try again.";
+                }
+                else if (journal.create(journal_path(save_id), start, start_fen, history))
+                {
+                    std::cout << "\n\n\t\t\tSave successful. From now on each move is saved as soon as it is played.";
+                }
+                else    std::cout << "\n\n\t\t\tSave failed. Please try again.";
+            }
+            else if (o == "u" || o == "U")
+            {
+                // Against the computer, undo takes back the computer's reply as well as your move.
+                int plies = (computer_color >= 0) ? 2 : 1;
+                if (history.size < plies)
+                {
+                    std::cout << "\n\tThere are no moves to undo.\n";
+                }
+                else
+                {
+                    ponder.cancel();
+                    for (int i = 0 ; i < plies ; i++)
+                    {
+                        my_board.unmake_move(history);
+                        journal.append_undo();
+                    }
+                    if (plies == 2) whites_turn = !whites_turn;
+                    std::cout << "\n\tUndo move successful.\n";
+                    looking_for_valid_move = false;
+                }
+            }
+            else if (o == "b" || o == "B")
+            {
+                Move moves [MAX_MOVES];
+                int weights [MAX_MOVES], total = 0;
+                int count = opening_book.probe(my_board, moves, weights, MAX_MOVES);
+                for (int i = 0 ; i < count ; i++)   total += weights[i];
+                if (!opening_book.is_open())    std::cout << "\n\tThere is no opening book. Start the program with book=<file> to use one.\n";
+                else if (count == 0)            std::cout << "\n\tThis position isn't in the opening book.\n";
+                else
+                {
+                    std::cout << "\n\tThe opening book suggests";
+                    for (int i = 0 ; i < count ; i++)
+                    {
+                        std::cout << (i == 0 ? " " : ", ") << integer_to_chess_notation(moves[i].origin()) << " to " << integer_to_chess_notation(moves[i].destination());
+                        if (total > 0)  std::cout << " (" << 100 * weights[i] / total << "%)";
+                    }
+                    std::cout << ".\n";
+                }
+                whites_turn = !whites_turn;
+                looking_for_valid_move = false;
+            }
+            else if (o == "m" || o == "M")
+            {
+                std::cout << "\tWhich piece? Enter its square: ";
+                std::cin >> d;
+                // The square is read as a move to itself, so it is checked the same way as any other square typed.
+                Move m;
+                if (parse_move(my_board, d + d, m) != MOVE_OK)  std::cout << "\n\t" << move_error_message(BAD_NOTATION) << "\n";
+                else if (!legal.from(m.origin()))               std::cout << "\n\tThe piece on " << integer_to_chess_notation(m.origin()) << " has no legal moves.\n";
+                else
+                {
+                    std::cout << "\n\tThe piece on " << integer_to_chess_notation(m.origin()) << " can move to";
+                    Bitboard targets = legal.from(m.origin());
+                    for (bool first = true ; targets ; first = false)    std::cout << (first ? " " : ", ") << integer_to_chess_notation(pop_lowest_square(targets));
+                    std::cout << ".\n";
+                }
+                whites_turn = !whites_turn;
+                looking_for_valid_move = false;
+            }
+            else if (o == "f" || o == "F")
+            {
+                std::cout << "\n\t" << my_board.to_fen() << "\n";
+                whites_turn = !whites_turn;
+                looking_for_valid_move = false;
+            }
+            else if (o == "v" || o == "V")
+            {
+                bool alternator = true;
+                std::cout << "\n\n\t====================\n";
+                for (int i = 0 ; i < history.size ; i++)
+                {
+                    Move m = history.records[i].move;
+                    if (i > 0)      std::cout << "\n";
+                    if (alternator) std::cout << "\tWhite moved from ";
+                    else            std::cout << "\tBlack moved from ";
+                    alternator = !alternator;
+                    std::cout << integer_to_chess_notation(m.origin()) << " to " << integer_to_chess_notation(m.destination());
+                }
+                if (history.empty()) {
+                    std::cout << "This is a brand new game! There have been no moves so far.";
+                }
+                std::cout << "\n\t====================\n\n";
+                whites_turn = !whites_turn;
+                looking_for_valid_move = false;
+            }
+            else
+            {
+                std::cout << "\tWhere do you move it?: ";
+                std::cin >> d;
+
+                Move m;
+                MoveError error = read_move(my_board, legal, o + d, m);
+                if (error >= LEAVES_KING_IN_CHECK && error <= PINNED_PIECE) std::cout << "\n\n\t" << move_error_message(error);
+                else if (error != MOVE_OK)                                  std::cout << "\n\n\tThat move is not valid. " << move_error_message(error);
+                else
+                {
+                    my_board.make_move(m, history);
+                    journal.append(m);
+                    looking_for_valid_move = false;
+                }
+            }
+        }
+        
+        render(my_board);
+
+        if (check_for_check(&my_board, !whites_turn))
+        {
+            if (check_for_checkmate(my_board, whites_turn))
+            {
+                std::cout << "\n\n\t\t======================================";
+                std::cout << "\n\t\t\t\tCHECKMATE!\n\n";
+                std::cout << "\n\t\t======================================";
+                journal.finish(whites_turn ? WHITE_WINS : BLACK_WINS);
+                game_in_progress = false;
+            } else  std::cout << "\n\t\t\t\tCheck!\n";
+        }
+        else if (check_for_stalemate(my_board, whites_turn))
+        {
+            std::cout << "\n\n\t\t======================================";
+            std::cout << "\n\t\t\t\tSTALEMATE!\n\n";
+            std::cout << "\n\t\t======================================";
+            journal.finish(DRAW);
+            game_in_progress = false;
+        }
+
+        whites_turn = !whites_turn;
+    }
+
+    return 1;
 }
\ No newline at end of file
@@ -0,0 +1,2938 @@
+// The textchess library: tables, move generation, move validation and the search declared in textchess.h.
+
+#include "textchess.h"
+
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <ostream>
+#include <mutex>
+#include <functional>
+#include <filesystem>
+#include <cassert>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+Bitboard knight_attacks [64];
+Bitboard king_attacks [64];
+Bitboard pawn_attacks [2][64];
+Bitboard between_squares [64][64];
+Bitboard line_through [64][64];
+
+Magic rook_magics [64];
+Magic bishop_magics [64];
+Bitboard rook_table [0x19000];
+Bitboard bishop_table [0x1480];
+
+// slide() walks from a square in each of the given (file, rank) directions until it leaves the board or reaches an occupied square.
+// It is only used to build the tables, so speed doesn't matter here.
+Bitboard slide(int square, Bitboard occupied, const int directions [4][2])
+{
+    Bitboard attacks = 0;
+    for (int d = 0 ; d < 4 ; d++)
+    {
+        int file = square % 8 + directions[d][0];
+        int rank = square / 8 + directions[d][1];
+        while (file >= 0 && file < 8 && rank >= 0 && rank < 8)
+        {
+            attacks |= square_bit(8 * rank + file);
+            if (occupied & square_bit(8 * rank + file))  break;
+            file += directions[d][0];
+            rank += directions[d][1];
+        }
+    }
+    return attacks;
+}
+
+// step_attacks() returns the squares one step away from a square in each of the given (file, rank) offsets.
+Bitboard step_attacks(int square, const int offsets [][2], int count)
+{
+    Bitboard attacks = 0;
+    for (int i = 0 ; i < count ; i++)
+    {
+        int file = square % 8 + offsets[i][0];
+        int rank = square / 8 + offsets[i][1];
+        if (file >= 0 && file < 8 && rank >= 0 && rank < 8)  attacks |= square_bit(8 * rank + file);
+    }
+    return attacks;
+}
+
+// init_magics() fills the magic lookup data and attack table for one slider type.
+// Without BMI2, magic numbers are found by trial with a fixed seed, so the tables are identical on every run.
+void init_magics(Magic * magics, Bitboard * table, const int directions [4][2])
+{
+    static Bitboard occupancy [4096], reference [4096];
+    // epoch[] marks each slot with the attempt that last filled it. Attempts are counted afresh for each slider type, so the marks
+    // left by the previous call are cleared first, or they would pass for slots this attempt has already filled.
+    static int epoch [4096];
+    std::fill(epoch, epoch + 4096, 0);
+    // Seeds for each rank that are known to find magics quickly with this generator.
+    const uint64_t seeds [8] = {728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+    int attempt = 0;
+    Bitboard * next = table;
+
+    for (int square = 0 ; square < 64 ; square++)
+    {
+        // Edge squares never block anything further along the ray, so they are left out of the mask.
+        Bitboard edges = ((0xFFULL | 0xFF00000000000000ULL) & ~(0xFFULL << (8 * (square / 8))))
+                       | ((0x0101010101010101ULL | 0x8080808080808080ULL) & ~(0x0101010101010101ULL << (square % 8)));
+        Magic & m = magics[square];
+        m.mask = slide(square, 0, directions) & ~edges;
+        m.shift = 64 - popcount(m.mask);
+        m.attacks = next;
+
+        // Enumerate every subset of the mask with the Carry-Rippler trick and record its true attacks.
+        int size = 0;
+        Bitboard subset = 0;
+        do
+        {
+            occupancy[size] = subset;
+            reference[size] = slide(square, subset, directions);
+#if defined(__BMI2__)
+            m.attacks[_pext_u64(subset, m.mask)] = reference[size];
+#endif
+            size++;
+            subset = (subset - m.mask) & m.mask;
+        } while (subset);
+        next += size;
+
+#if !defined(__BMI2__)
+        uint64_t seed = seeds[square / 8];
+        // Try sparse random numbers until one maps every subset to a slot without a destructive collision.
+        for (int i = 0 ; i < size ; )
+        {
+            for (m.magic = 0 ; popcount((m.magic * m.mask) >> 56) < 6 ; )
+            {
+                Bitboard r = ~0ULL;
+                for (int k = 0 ; k < 3 ; k++)
+                {
+                    seed ^= seed >> 12;
+                    seed ^= seed << 25;
+                    seed ^= seed >> 27;
+                    r &= seed * 2685821657736338717ULL;
+                }
+                m.magic = r;
+            }
+            attempt++;
+            for (i = 0 ; i < size ; i++)
+            {
+                unsigned idx = m.index(occupancy[i]);
+                if (epoch[idx] < attempt)
+                {
+                    epoch[idx] = attempt;
+                    m.attacks[idx] = reference[i];
+                }
+                else if (m.attacks[idx] != reference[i])    break;
+            }
+        }
+#endif
+    }
+}
+
+// init_attack_tables() builds every attack table. It runs once, before main(), through the TableInitializer below.
+void init_attack_tables()
+{
+    const int knight_offsets [8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+    const int king_offsets [8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+    const int white_pawn_offsets [2][2] = {{-1, 1}, {1, 1}};
+    const int black_pawn_offsets [2][2] = {{-1, -1}, {1, -1}};
+    const int rook_directions [4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    const int bishop_directions [4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+    for (int square = 0 ; square < 64 ; square++)
+    {
+        knight_attacks[square] = step_attacks(square, knight_offsets, 8);
+        king_attacks[square] = step_attacks(square, king_offsets, 8);
+        pawn_attacks[WHITE][square] = step_attacks(square, white_pawn_offsets, 2);
+        pawn_attacks[BLACK][square] = step_attacks(square, black_pawn_offsets, 2);
+    }
+    init_magics(rook_magics, rook_table, rook_directions);
+    init_magics(bishop_magics, bishop_table, bishop_directions);
+
+    for (int a = 0 ; a < 64 ; a++)
+    {
+        for (int b = 0 ; b < 64 ; b++)
+        {
+            between_squares[a][b] = 0;
+            line_through[a][b] = 0;
+            if (a == b) continue;
+            if (bishop_attacks(a, 0) & square_bit(b))
+            {
+                between_squares[a][b] = bishop_attacks(a, square_bit(b)) & bishop_attacks(b, square_bit(a));
+                line_through[a][b] = (bishop_attacks(a, 0) & bishop_attacks(b, 0)) | square_bit(a) | square_bit(b);
+            }
+            if (rook_attacks(a, 0) & square_bit(b))
+            {
+                between_squares[a][b] = rook_attacks(a, square_bit(b)) & rook_attacks(b, square_bit(a));
+                line_through[a][b] = (rook_attacks(a, 0) & rook_attacks(b, 0)) | square_bit(a) | square_bit(b);
+            }
+        }
+    }
+}
+
+uint64_t zobrist_piece_square [16][64];
+uint64_t zobrist_side;
+uint64_t zobrist_en_passant [8];
+
+// init_zobrist_keys() fills the Zobrist keys from a fixed seed, so a position has the same key on every run and in every saved file.
+void init_zobrist_keys()
+{
+    uint64_t seed = 1070372;
+    auto next = [&seed]()
+    {
+        seed ^= seed >> 12;
+        seed ^= seed << 25;
+        seed ^= seed >> 27;
+        return seed * 2685821657736338717ULL;
+    };
+    for (int p = 0 ; p < 16 ; p++)
+    {
+        for (int square = 0 ; square < 64 ; square++)   zobrist_piece_square[p][square] = next();
+    }
+    zobrist_side = next();
+    for (int file = 0 ; file < 8 ; file++)  zobrist_en_passant[file] = next();
+}
+
+alignas(32) int16_t psq_mg [16][64];
+alignas(32) int16_t psq_eg [16][64];
+
+// Piece-square bonuses for white, in centipawns, for each piece type in the middlegame and then the endgame.
+// They are laid out as the board is seen from white's side, so the first row is the eighth rank.
+const int8_t psq_bonus [2][6][64] = {
+    {
+        {  0,   0,   0,   0,   0,   0,   0,   0,
+          50,  50,  50,  50,  50,  50,  50,  50,
+          10,  10,  20,  30,  30,  20,  10,  10,
+           5,   5,  10,  25,  25,  10,   5,   5,
+           0,   0,   0,  20,  20,   0,   0,   0,
+           5,  -5, -10,   0,   0, -10,  -5,   5,
+           5,  10,  10, -20, -20,  10,  10,   5,
+           0,   0,   0,   0,   0,   0,   0,   0},
+        {-50, -40, -30, -30, -30, -30, -40, -50,
+         -40, -20,   0,   0,   0,   0, -20, -40,
+         -30,   0,  10,  15,  15,  10,   0, -30,
+         -30,   5,  15,  20,  20,  15,   5, -30,
+         -30,   0,  15,  20,  20,  15,   0, -30,
+         -30,   5,  10,  15,  15,  10,   5, -30,
+         -40, -20,   0,   5,   5,   0, -20, -40,
+         -50, -40, -30, -30, -30, -30, -40, -50},
+        {-20, -10, -10, -10, -10, -10, -10, -20,
+         -10,   0,   0,   0,   0,   0,   0, -10,
+         -10,   0,   5,  10,  10,   5,   0, -10,
+         -10,   5,   5,  10,  10,   5,   5, -10,
+         -10,   0,  10,  10,  10,  10,   0, -10,
+         -10,  10,  10,  10,  10,  10,  10, -10,
+         -10,   5,   0,   0,   0,   0,   5, -10,
+         -20, -10, -10, -10, -10, -10, -10, -20},
+        {  0,   0,   0,   0,   0,   0,   0,   0,
+           5,  10,  10,  10,  10,  10,  10,   5,
+          -5,   0,   0,   0,   0,   0,   0,  -5,
+          -5,   0,   0,   0,   0,   0,   0,  -5,
+          -5,   0,   0,   0,   0,   0,   0,  -5,
+          -5,   0,   0,   0,   0,   0,   0,  -5,
+          -5,   0,   0,   0,   0,   0,   0,  -5,
+           0,   0,   0,   5,   5,   0,   0,   0},
+        {-20, -10, -10,  -5,  -5, -10, -10, -20,
+         -10,   0,   0,   0,   0,   0,   0, -10,
+         -10,   0,   5,   5,   5,   5,   0, -10,
+          -5,   0,   5,   5,   5,   5,   0,  -5,
+           0,   0,   5,   5,   5,   5,   0,  -5,
+         -10,   5,   5,   5,   5,   5,   0, -10,
+         -10,   0,   5,   0,   0,   0,   0, -10,
+         -20, -10, -10,  -5,  -5, -10, -10, -20},
+        {-30, -40, -40, -50, -50, -40, -40, -30,
+         -30, -40, -40, -50, -50, -40, -40, -30,
+         -30, -40, -40, -50, -50, -40, -40, -30,
+         -30, -40, -40, -50, -50, -40, -40, -30,
+         -20, -30, -30, -40, -40, -30, -30, -20,
+         -10, -20, -20, -20, -20, -20, -20, -10,
+          20,  20,   0,   0,   0,   0,  20,  20,
+          20,  30,  10,   0,   0,  10,  30,  20}
+    },
+    {
+        {  0,   0,   0,   0,   0,   0,   0,   0,
+          80,  80,  80,  80,  80,  80,  80,  80,
+          50,  50,  50,  50,  50,  50,  50,  50,
+          30,  30,  30,  30,  30,  30,  30,  30,
+          20,  20,  20,  20,  20,  20,  20,  20,
+          10,  10,  10,  10,  10,  10,  10,  10,
+           0,   0,   0,   0,   0,   0,   0,   0,
+           0,   0,   0,   0,   0,   0,   0,   0},
+        {-50, -40, -30, -30, -30, -30, -40, -50,
+         -40, -20,   0,   0,   0,   0, -20, -40,
+         -30,   0,  10,  15,  15,  10,   0, -30,
+         -30,   5,  15,  20,  20,  15,   5, -30,
+         -30,   0,  15,  20,  20,  15,   0, -30,
+         -30,   5,  10,  15,  15,  10,   5, -30,
+         -40, -20,   0,   5,   5,   0, -20, -40,
+         -50, -40, -30, -30, -30, -30, -40, -50},
+        {-20, -10, -10, -10, -10, -10, -10, -20,
+         -10,   0,   0,   0,   0,   0,   0, -10,
+         -10,   0,   5,  10,  10,   5,   0, -10,
+         -10,   5,   5,  10,  10,   5,   5, -10,
+         -10,   0,  10,  10,  10,  10,   0, -10,
+         -10,  10,  10,  10,  10,  10,  10, -10,
+         -10,   5,   0,   0,   0,   0,   5, -10,
+         -20, -10, -10, -10, -10, -10, -10, -20},
+        {  0,   0,   0,   0,   0,   0,   0,   0,
+           0,   0,   0,   0,   0,   0,   0,   0,
+           0,   0,   0,   0,   0,   0,   0,   0,
+           0,   0,   0,   0,   0,   0,   0,   0,
+           0,   0,   0,   0,   0,   0,   0,   0,
+           0,   0,   0,   0,   0,   0,   0,   0,
+           0,   0,   0,   0,   0,   0,   0,   0,
+           0,   0,   0,   0,   0,   0,   0,   0},
+        {-20, -10, -10,  -5,  -5, -10, -10, -20,
+         -10,   0,   0,   0,   0,   0,   0, -10,
+         -10,   0,   5,   5,   5,   5,   0, -10,
+          -5,   0,   5,   5,   5,   5,   0,  -5,
+          -5,   0,   5,   5,   5,   5,   0,  -5,
+         -10,   0,   5,   5,   5,   5,   0, -10,
+         -10,   0,   0,   0,   0,   0,   0, -10,
+         -20, -10, -10,  -5,  -5, -10, -10, -20},
+        {-50, -40, -30, -20, -20, -30, -40, -50,
+         -30, -20, -10,   0,   0, -10, -20, -30,
+         -30, -10,  20,  30,  30,  20, -10, -30,
+         -30, -10,  30,  40,  40,  30, -10, -30,
+         -30, -10,  30,  40,  40,  30, -10, -30,
+         -30, -10,  20,  30,  30,  20, -10, -30,
+         -30, -30,   0,   0,   0,   0, -30, -30,
+         -50, -30, -30, -30, -30, -30, -30, -50}
+    }
+};
+
+// init_psq_tables() fills psq_mg and psq_eg from the piece values and psq_bonus. A black piece scores what a white one would on
+// the square mirrored across the middle of the board, with the sign turned around.
+void init_psq_tables()
+{
+    for (int type = PAWN ; type <= KING ; type++)
+    {
+        for (int square = 0 ; square < 64 ; square++)
+        {
+            int white_row = 8 * (7 - square / 8) + square % 8;
+            int black_row = 8 * (square / 8) + square % 8;
+            psq_mg[make_piece(WHITE, type)][square] = piece_values[type] + psq_bonus[0][type][white_row];
+            psq_eg[make_piece(WHITE, type)][square] = piece_values[type] + psq_bonus[1][type][white_row];
+            psq_mg[make_piece(BLACK, type)][square] = -(piece_values[type] + psq_bonus[0][type][black_row]);
+            psq_eg[make_piece(BLACK, type)][square] = -(piece_values[type] + psq_bonus[1][type][black_row]);
+        }
+    }
+}
+
+// Masks for the pawn structure terms. adjacent_files[f] is every square on the files beside file f. For a pawn of color c on square s,
+// forward_span[c][s] is the squares in front of it on its file, passed_span[c][s] adds the squares in front of it on the files
+// beside, and support_span[c][s] is the squares on the files beside that are level with it or behind it.
+Bitboard adjacent_files [8];
+Bitboard forward_span [2][64];
+Bitboard passed_span [2][64];
+Bitboard support_span [2][64];
+
+// init_pawn_masks() fills the pawn structure masks.
+void init_pawn_masks()
+{
+    const Bitboard file_a = 0x0101010101010101ULL;
+    for (int file = 0 ; file < 8 ; file++)
+    {
+        adjacent_files[file] = (file > 0 ? file_a << (file - 1) : 0) | (file < 7 ? file_a << (file + 1) : 0);
+    }
+    for (int square = 0 ; square < 64 ; square++)
+    {
+        // The ranks in front of the square for white, and those in front of it for black.
+        Bitboard above = square / 8 < 7 ? ~0ULL << (8 * (square / 8 + 1)) : 0;
+        Bitboard below = square / 8 > 0 ? ~0ULL >> (8 * (8 - square / 8)) : 0;
+        Bitboard file = file_a << (square % 8);
+        Bitboard beside = adjacent_files[square % 8];
+        forward_span[WHITE][square] = file & above;
+        forward_span[BLACK][square] = file & below;
+        passed_span[WHITE][square] = (file | beside) & above;
+        passed_span[BLACK][square] = (file | beside) & below;
+        support_span[WHITE][square] = beside & ~above;
+        support_span[BLACK][square] = beside & ~below;
+    }
+}
+
+struct TableInitializer
+{
+    TableInitializer()
+    {
+        init_attack_tables();
+        init_zobrist_keys();
+        init_psq_tables();
+        init_pawn_masks();
+    }
+} table_initializer;
+
+void Board::compute_scores(int & mg, int & eg, int * values) const
+{
+    values[WHITE] = values[BLACK] = 0;
+    for (int color = WHITE ; color <= BLACK ; color++)
+    {
+        for (int type = KNIGHT ; type <= QUEEN ; type++)    values[color] += piece_values[type] * popcount(pieces[color][type]);
+    }
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    // Each piece bitboard is spread into masks of 16-bit lanes, one lane per square, that pick out its row of the tables.
+    // A square holds one piece at most, so every lane takes in one entry at most and can't overflow before the lanes are added up.
+#if defined(__AVX2__)
+    typedef __m256i Lanes;
+    const int width = 16;
+    const Lanes bits = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, -32768);
+    auto spread = [&](Bitboard b, int first) {return _mm256_cmpeq_epi16(_mm256_and_si256(_mm256_set1_epi16((int16_t)(b >> first)), bits), bits);};
+    auto load = [](const int16_t * row) {return _mm256_load_si256((const Lanes *)row);};
+    auto add = [](Lanes a, Lanes b) {return _mm256_add_epi16(a, b);};
+    auto select = [](Lanes mask, Lanes values) {return _mm256_and_si256(mask, values);};
+    // Adding neighbouring lanes in pairs widens them to 32 bits, and then the two halves and the four words of each are added.
+    auto total = [](Lanes sum)
+    {
+        __m256i pairs = _mm256_madd_epi16(sum, _mm256_set1_epi16(1));
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(pairs), _mm256_extracti128_si256(pairs, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(half);
+    };
+    Lanes zero = _mm256_setzero_si256();
+#else
+    typedef __m128i Lanes;
+    const int width = 8;
+    const Lanes bits = _mm_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128);
+    auto spread = [&](Bitboard b, int first) {return _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16((int16_t)(b >> first)), bits), bits);};
+    auto load = [](const int16_t * row) {return _mm_load_si128((const Lanes *)row);};
+    auto add = [](Lanes a, Lanes b) {return _mm_add_epi16(a, b);};
+    auto select = [](Lanes mask, Lanes values) {return _mm_and_si128(mask, values);};
+    // Adding neighbouring lanes in pairs widens them to 32 bits, and then the four words are added.
+    auto total = [](Lanes sum)
+    {
+        __m128i pairs = _mm_madd_epi16(sum, _mm_set1_epi16(1));
+        pairs = _mm_add_epi32(pairs, _mm_shuffle_epi32(pairs, _MM_SHUFFLE(1, 0, 3, 2)));
+        pairs = _mm_add_epi32(pairs, _mm_shuffle_epi32(pairs, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(pairs);
+    };
+    Lanes zero = _mm_setzero_si128();
+#endif
+    Lanes sum_mg [64 / width], sum_eg [64 / width];
+    for (int i = 0 ; i < 64 / width ; i++)  sum_mg[i] = sum_eg[i] = zero;
+    for (int color = WHITE ; color <= BLACK ; color++)
+    {
+        for (int type = PAWN ; type <= KING ; type++)
+        {
+            Bitboard b = pieces[color][type];
+            Piece p = make_piece(color, type);
+            for (int i = 0 ; b && i < 64 / width ; i++)
+            {
+                Lanes mask = spread(b, width * i);
+                sum_mg[i] = add(sum_mg[i], select(mask, load(&psq_mg[p][width * i])));
+                sum_eg[i] = add(sum_eg[i], select(mask, load(&psq_eg[p][width * i])));
+            }
+        }
+    }
+    mg = eg = 0;
+    for (int i = 0 ; i < 64 / width ; i++)
+    {
+        mg += total(sum_mg[i]);
+        eg += total(sum_eg[i]);
+    }
+#else
+    mg = eg = 0;
+    for (int square = 0 ; square < 64 ; square++)
+    {
+        mg += psq_mg[mailbox[square]][square];
+        eg += psq_eg[mailbox[square]][square];
+    }
+#endif
+}
+
+#if defined(TEXTCHESS_CHECK_EVAL)
+// check_scores() stops the program if the scores kept on board differ from a full recompute. It runs after every move and
+// take-back in builds made with -DTEXTCHESS_CHECK_EVAL.
+static void check_scores(const Board & board)
+{
+    int mg, eg, values [2];
+    board.compute_scores(mg, eg, values);
+    assert(mg == board.mg_score && eg == board.eg_score && values[WHITE] == board.material[WHITE] && values[BLACK] == board.material[BLACK]);
+}
+#endif
+
+// make_move() plays a move for the side to move and pushes what is needed to take it back onto history.
+// It does not check that the move is legal.
+void Board::make_move(Move m, UndoStack & history)
+{
+    int us = side_to_move;
+    int origin = m.origin();
+    int destination = m.destination();
+
+    Undo & undo = history.push();
+    undo.key = key;
+    undo.move = m;
+    undo.captured = mailbox[destination];
+    undo.en_passant_square = en_passant_square;
+    undo.halfmove_clock = halfmove_clock;
+    undo.attacked[WHITE] = attacked[WHITE];
+    undo.attacked[BLACK] = attacked[BLACK];
+    undo.checkers = checkers;
+
+    halfmove_clock++;
+    if (undo.captured != EMPTY || type_at(origin) == PAWN)  halfmove_clock = 0;
+
+    if (undo.captured != EMPTY)     remove_piece(destination);
+    move_piece(origin, destination);
+    if (m.flag() == PROMOTION)
+    {
+        remove_piece(destination);
+        put_piece(us, m.promotion(), destination);
+    }
+    // The pawn taken en passant stands beside the origin, one rank behind the destination.
+    else if (m.flag() == EN_PASSANT)    remove_piece(destination + (us == WHITE ? -8 : 8));
+
+    // The en passant square is only recorded when an enemy pawn could actually capture there, so it never splits one position into two keys.
+    if (en_passant_square >= 0) key ^= zobrist_en_passant[en_passant_square % 8];
+    en_passant_square = -1;
+    if (type_at(destination) == PAWN && std::abs(destination - origin) == 16)
+    {
+        int skipped = (origin + destination) / 2;
+        if (pawn_attacks[us][skipped] & pieces[!us][PAWN])
+        {
+            en_passant_square = skipped;
+            key ^= zobrist_en_passant[skipped % 8];
+        }
+    }
+    if (us == BLACK)    fullmove_number++;
+    side_to_move = !us;
+    key ^= zobrist_side;
+
+    // The mover's attacks are worked out again in full. Each map is a single union with no record of which piece covers which
+    // square, so the moved piece's old attacks can't be taken out without going over every other piece that might share them,
+    // and that is the whole recompute: a few table lookups and one magic lookup per slider. The other side's only change if it
+    // lost a piece, or if the move opened or closed a line one of its sliders looks along, which can only happen on a square it
+    // already attacks.
+    if (type_at(destination) == KING)   king_square[us] = destination;
+    Bitboard changed = square_bit(origin) | square_bit(destination);
+    if (undo.captured != EMPTY || m.flag() == EN_PASSANT || (changed & attacked[!us]))  attacked[!us] = attacks_by(!us);
+    attacked[us] = attacks_by(us);
+    checkers = (attacked[us] & pieces[!us][KING]) ? attackers_to(king_square[!us], all_pieces()) & occupied[us] : 0;
+#if defined(TEXTCHESS_CHECK_EVAL)
+    check_scores(*this);
+#endif
+}
+
+// unmake_move() takes back the last move pushed onto history.
+void Board::unmake_move(UndoStack & history)
+{
+    const Undo & undo = history.pop();
+    int us = !side_to_move;
+    int origin = undo.move.origin();
+    int destination = undo.move.destination();
+
+    if (undo.move.flag() == PROMOTION)
+    {
+        remove_piece(destination);
+        put_piece(us, PAWN, destination);
+    }
+    move_piece(destination, origin);
+    if (undo.captured != EMPTY)                 put_piece(!us, piece_type(undo.captured), destination);
+    if (undo.move.flag() == EN_PASSANT)         put_piece(!us, PAWN, destination + (us == WHITE ? -8 : 8));
+
+    en_passant_square = undo.en_passant_square;
+    halfmove_clock = undo.halfmove_clock;
+    if (us == BLACK)    fullmove_number--;
+    side_to_move = us;
+    key = undo.key;
+    if (type_at(origin) == KING)    king_square[us] = origin;
+    attacked[WHITE] = undo.attacked[WHITE];
+    attacked[BLACK] = undo.attacked[BLACK];
+    checkers = undo.checkers;
+#if defined(TEXTCHESS_CHECK_EVAL)
+    check_scores(*this);
+#endif
+}
+
+// from_fen() sets up the position described by a FEN string (i.e. "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b - e3 0 1").
+// Castling rights are checked but ignored, since the program doesn't support castling, and the move counters may be left off.
+// If the string can't be read, it returns false, leaves the board unchanged and, if error is given, says what was wrong with it.
+bool Board::from_fen(const std::string & fen, std::string * error)
+{
+    auto fail = [error](const char * reason)
+    {
+        if (error)  *error = reason;
+        return false;
+    };
+
+    std::istringstream fields(fen);
+    std::string placement, side, castling = "-", en_passant = "-", halfmove = "0", fullmove = "1", extra;
+    fields >> placement >> side >> castling >> en_passant >> halfmove >> fullmove;
+    if (fields >> extra)    return fail("there is more text after the move counters");
+
+    Board b;
+    b.clear();
+    int rank = 7;
+    int file = 0;
+    for (char c : placement)
+    {
+        size_t piece = std::string("PNBRQKpnbrqk").find(c);
+        if (c == '/')
+        {
+            if (file != 8 || rank == 0) return fail("each rank must describe exactly 8 squares, and there must be 8 ranks");
+            rank--;
+            file = 0;
+        }
+        else if (c >= '1' && c <= '8')  file += c - '0';
+        else if (piece == std::string::npos)    return fail("the piece placement may only use the letters PNBRQK, pnbrqk, the digits 1-8 and /");
+        else if (file < 8)
+        {
+            b.put_piece(piece / 6, piece % 6, 8 * rank + file);
+            file++;
+        }
+        else    file = 9;
+        if (file > 8)   return fail("each rank must describe exactly 8 squares, and there must be 8 ranks");
+    }
+    if (rank != 0 || file != 8) return fail("each rank must describe exactly 8 squares, and there must be 8 ranks");
+    if ((b.pieces[WHITE][PAWN] | b.pieces[BLACK][PAWN]) & 0xFF000000000000FFULL)    return fail("pawns can't stand on the first or eighth rank");
+
+    if (side == "w")        b.side_to_move = WHITE;
+    else if (side == "b")   b.side_to_move = BLACK;
+    else                    return fail("the side to move must be w or b");
+
+    if (castling.empty() || (castling != "-" && castling.find_first_not_of("KQkq") != std::string::npos))  return fail("castling rights must be - or letters from KQkq");
+
+    if (en_passant != "-")
+    {
+        if (en_passant.size() != 2 || en_passant[0] < 'a' || en_passant[0] > 'h' || en_passant[1] != (b.side_to_move == WHITE ? '6' : '3'))
+        {
+            return fail("the en passant square must be - or a square on the sixth rank of the side that just moved");
+        }
+        b.en_passant_square = 8 * (en_passant[1] - '1') + (en_passant[0] - 'a');
+        // The pawn that just moved two squares must stand in front of the en passant square, with it and the square it came from empty.
+        int direction = (b.side_to_move == WHITE) ? 8 : -8;
+        int pushed = b.en_passant_square - direction;
+        if (!(b.pieces[!b.side_to_move][PAWN] & square_bit(pushed)) || !b.is_empty(b.en_passant_square) || !b.is_empty(b.en_passant_square + direction))
+        {
+            return fail("the en passant square must be empty and behind a pawn that has just moved two squares from an empty square");
+        }
+        // Like make_move(), only keep an en passant square that a pawn could capture on.
+        if (!(pawn_attacks[!b.side_to_move][b.en_passant_square] & b.pieces[b.side_to_move][PAWN]))  b.en_passant_square = -1;
+    }
+
+    for (const std::string & counter : {halfmove, fullmove})
+    {
+        if (counter.empty() || counter.size() > 5 || counter.find_first_not_of("0123456789") != std::string::npos)  return fail("the move counters must be whole numbers");
+    }
+    b.halfmove_clock = std::stoi(halfmove);
+    b.fullmove_number = std::max(std::stoi(fullmove), 1);
+
+    // Each side needs exactly one king, and the side that just moved can't have left its king in check.
+    if (popcount(b.pieces[WHITE][KING]) != 1 || popcount(b.pieces[BLACK][KING]) != 1)  return fail("each side must have exactly one king");
+    if (b.is_attacked(lowest_square(b.pieces[!b.side_to_move][KING]), b.side_to_move))  return fail("the side that just moved can't be in check");
+
+    b.key = b.compute_key();
+    b.compute_scores(b.mg_score, b.eg_score, b.material);
+    b.update_attacks();
+    *this = b;
+    return true;
+}
+
+// to_fen() describes the position as a FEN string. Castling rights are always "-", and the en passant square is only
+// written when a pawn can actually capture there, so the same position always gives the same string.
+std::string Board::to_fen() const
+{
+    std::string fen;
+    for (int rank = 7 ; rank >= 0 ; rank--)
+    {
+        int empty = 0;
+        for (int file = 0 ; file < 8 ; file++)
+        {
+            int square = 8 * rank + file;
+            if (is_empty(square))
+            {
+                empty++;
+                continue;
+            }
+            if (empty > 0)  fen += '0' + empty;
+            empty = 0;
+            fen += display(square);
+        }
+        if (empty > 0)  fen += '0' + empty;
+        if (rank > 0)   fen += '/';
+    }
+    fen += side_to_move == WHITE ? " w - " : " b - ";
+    fen += en_passant_square >= 0 ? integer_to_chess_notation(en_passant_square) : "-";
+    fen += " " + std::to_string(halfmove_clock) + " " + std::to_string(fullmove_number);
+    return fen;
+}
+
+// chess_notation_to_integer() accepts a string in chess notation (i.e. "e4") and returns the corresponding array location.
+int chess_notation_to_integer(std::string code) {
+    int file = -1;
+    std::string str_file = code.substr(0, 1);
+    std::string letters = "abcdefgh";
+    std::string u_letters = "ABCDEFGH";
+
+    file = letters.find(str_file, 0);
+    if (file == std::string::npos)   file = u_letters.find(str_file, 0);
+
+    int rank = std::stoi(code.substr(1, 1));
+
+    return (8 * (rank - 1)) + file;
+}
+
+// check_for_check() returns true if the king of the given color is in check.
+bool check_for_check(const Board * currentBoard, bool white) {
+
+    int color = white ? WHITE : BLACK;
+    return currentBoard->attacked[!color] & currentBoard->pieces[color][KING];
+
+}
+
+// generate_moves() adds the legal moves of the side to move to list.
+// Legality comes from check and pin masks rather than from playing each move out, so the board is never copied or changed.
+// With FirstOnly set, it returns as soon as it has found a single legal move.
+// With CapturesOnly set, it only adds captures and promotions, which is all a quiescence search looks at.
+template <bool FirstOnly, bool CapturesOnly = false>
+void generate_moves(const Board & board, MoveList & list)
+{
+    int us = board.side_to_move;
+    int them = !us;
+    Bitboard occupancy = board.all_pieces();
+    Bitboard ours = board.occupied[us];
+    Bitboard theirs = board.occupied[them];
+    Bitboard their_rooks = board.pieces[them][ROOK] | board.pieces[them][QUEEN];
+    Bitboard their_bishops = board.pieces[them][BISHOP] | board.pieces[them][QUEEN];
+    int king = board.king_square[us];
+    Bitboard allowed = CapturesOnly ? theirs : ~ours;
+
+    // The enemy attack map already sees through our king, so it can't shelter behind its own square from a slider.
+    Bitboard targets = king_attacks[king] & allowed & ~board.attacked[them];
+    while (targets)
+    {
+        list.add(Move(king, pop_lowest_square(targets)));
+        if (FirstOnly)  return;
+    }
+
+    // In double check only the king can move. In single check every other move must capture the checker or block it.
+    Bitboard checkers = board.checkers;
+    if (popcount(checkers) > 1) return;
+    Bitboard check_mask = ~0ULL;
+    if (checkers)   check_mask = checkers | between_squares[king][lowest_square(checkers)];
+
+    // A piece is pinned if it is the only thing standing between its king and an enemy slider on the same line.
+    Bitboard pinned = 0;
+    Bitboard snipers = (rook_attacks(king, 0) & their_rooks) | (bishop_attacks(king, 0) & their_bishops);
+    while (snipers)
+    {
+        Bitboard blockers = between_squares[king][pop_lowest_square(snipers)] & occupancy;
+        if (popcount(blockers) == 1 && (blockers & ours))   pinned |= blockers;
+    }
+
+    for (int type = KNIGHT ; type <= QUEEN ; type++)
+    {
+        Bitboard movers = board.pieces[us][type];
+        while (movers)
+        {
+            int origin = pop_lowest_square(movers);
+            targets = piece_attacks(type, us, origin, occupancy) & allowed & check_mask;
+            // A pinned piece may only slide along the line of its pin.
+            if (pinned & square_bit(origin))    targets &= line_through[king][origin];
+            while (targets)
+            {
+                list.add(Move(origin, pop_lowest_square(targets)));
+                if (FirstOnly)  return;
+            }
+        }
+    }
+
+    int direction = (us == WHITE) ? 8 : -8;
+    Bitboard start_rank = (us == WHITE) ? 0x000000000000FF00ULL : 0x00FF000000000000ULL;
+    Bitboard last_rank = (us == WHITE) ? 0xFF00000000000000ULL : 0x00000000000000FFULL;
+    Bitboard pawns = board.pieces[us][PAWN];
+    while (pawns)
+    {
+        int origin = pop_lowest_square(pawns);
+        targets = pawn_attacks[us][origin] & theirs;
+        if (!(occupancy & square_bit(origin + direction)))
+        {
+            if (!CapturesOnly || (last_rank & square_bit(origin + direction)))  targets |= square_bit(origin + direction);
+            if (!CapturesOnly && (start_rank & square_bit(origin)) && !(occupancy & square_bit(origin + 2 * direction)))   targets |= square_bit(origin + 2 * direction);
+        }
+        targets &= check_mask;
+        if (pinned & square_bit(origin))    targets &= line_through[king][origin];
+        while (targets)
+        {
+            int destination = pop_lowest_square(targets);
+            if (square_bit(destination) & last_rank)
+            {
+                for (int promotion = QUEEN ; promotion >= KNIGHT ; promotion--)  list.add(Move(origin, destination, PROMOTION, promotion));
+            }
+            else    list.add(Move(origin, destination));
+            if (FirstOnly)  return;
+        }
+
+        // En passant removes two pieces from the same rank, so the only sure way to rule out a discovered check is to look again from the king.
+        int ep = board.en_passant_square;
+        if (ep >= 0 && (pawn_attacks[us][origin] & square_bit(ep)))
+        {
+            int captured = ep - direction;
+            Bitboard after = (occupancy ^ square_bit(origin) ^ square_bit(captured)) | square_bit(ep);
+            bool answers_check = !checkers || (checkers & square_bit(captured)) || (check_mask & square_bit(ep));
+            bool exposes_king = (rook_attacks(king, after) & their_rooks) || (bishop_attacks(king, after) & their_bishops);
+            if (answers_check && !exposes_king)
+            {
+                list.add(Move(origin, ep, EN_PASSANT));
+                if (FirstOnly)  return;
+            }
+        }
+    }
+}
+
+// generate_legal_moves() fills list with every legal move for the side to move.
+void generate_legal_moves(const Board & board, MoveList & list)
+{
+    generate_moves<false>(board, list);
+}
+
+// generate_legal_captures() fills list with the legal captures and promotions for the side to move.
+void generate_legal_captures(const Board & board, MoveList & list)
+{
+    generate_moves<false, true>(board, list);
+}
+
+// has_legal_move() returns true if the side to move has at least one legal move. It stops at the first one it finds.
+bool has_legal_move(const Board & board)
+{
+    MoveList list;
+    generate_moves<true>(board, list);
+    return list.size > 0;
+}
+
+// check_for_checkmate() returns true if the player who just moved (white if whites_turn) has checkmated their opponent.
+bool check_for_checkmate(const Board & currentBoard, bool whites_turn) {
+
+    return check_for_check(&currentBoard, !whites_turn) && !has_legal_move(currentBoard);
+
+}
+
+// check_for_stalemate() returns true if the player who just moved (white if whites_turn) has left their opponent without a legal move while not in check.
+bool check_for_stalemate(const Board & currentBoard, bool whites_turn) {
+
+    return !check_for_check(&currentBoard, !whites_turn) && !has_legal_move(currentBoard);
+
+}
+
+// integer_to_chess_notation() is the reverse of chess_notation_to_integer(). It turns an array location into a square name like "e4".
+std::string integer_to_chess_notation(int square) {
+    std::string code = "a1";
+    code[0] += square % 8;
+    code[1] += square / 8;
+    return code;
+}
+
+// move_to_string() writes a move as origin and destination squares, followed by the promotion piece if there is one (i.e. "e2e4", "e7e8q").
+std::string move_to_string(Move m) {
+    std::string text = integer_to_chess_notation(m.origin()) + integer_to_chess_notation(m.destination());
+    if (m.flag() == PROMOTION)  text += "pnbrqk"[m.promotion()];
+    return text;
+}
+
+// perft() counts the positions reachable from the board in exactly depth moves.
+// The last ply is counted straight from the size of the move list rather than by playing each move.
+uint64_t perft(Board & board, UndoStack & history, int depth) {
+
+    MoveList list;
+    generate_legal_moves(board, list);
+    if (depth <= 1) return depth == 1 ? list.size : 1;
+
+    uint64_t nodes = 0;
+    for (Move m : list)
+    {
+        board.make_move(m, history);
+        nodes += perft(board, history, depth - 1);
+        board.unmake_move(history);
+    }
+    return nodes;
+
+}
+
+// parse_move() reads a move typed as two squares and an optional promotion piece. Spaces, an "=" before the promotion piece and
+// uppercase letters are all allowed. The move's flag is filled in from the board, so an en passant capture needs no special notation.
+MoveError parse_move(const Board & board, const std::string & text, Move & move) {
+
+    std::string compact;
+    for (char c : text)
+    {
+        if (c == ' ' || c == '\t' || c == '=')    continue;
+        compact += (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+    }
+    if (compact.size() != 4 && compact.size() != 5) return BAD_NOTATION;
+    for (int i = 0 ; i < 4 ; i += 2)
+    {
+        if (compact[i] < 'a' || compact[i] > 'h' || compact[i + 1] < '1' || compact[i + 1] > '8')  return BAD_NOTATION;
+    }
+
+    int origin = chess_notation_to_integer(compact.substr(0, 2));
+    int destination = chess_notation_to_integer(compact.substr(2, 2));
+    if (compact.size() == 5)
+    {
+        size_t promotion = std::string("nbrq").find(compact[4]);
+        if (promotion == std::string::npos) return BAD_NOTATION;
+        move = Move(origin, destination, PROMOTION, KNIGHT + (int)promotion);
+    }
+    else if (board.type_at(origin) == PAWN && destination == board.en_passant_square)   move = Move(origin, destination, EN_PASSANT);
+    else    move = Move(origin, destination);
+    return MOVE_OK;
+
+}
+
+// move_to_san() finds the other legal moves of the same kind of piece to the same square to decide how much of the origin to write.
+std::string move_to_san(Board & board, Move move, UndoStack & history) {
+
+    int origin = move.origin();
+    int destination = move.destination();
+    int type = board.type_at(origin);
+    bool capture = !board.is_empty(destination) || move.flag() == EN_PASSANT;
+    std::string san;
+    if (type == PAWN)
+    {
+        if (capture)    san += (char)('a' + origin % 8);
+    }
+    else
+    {
+        san += "NBRQK"[type - KNIGHT];
+        MoveList list;
+        generate_legal_moves(board, list);
+        bool same_file = false, same_rank = false, ambiguous = false;
+        for (Move other : list)
+        {
+            if (other.destination() != destination || other.origin() == origin || board.type_at(other.origin()) != type)    continue;
+            ambiguous = true;
+            if (other.origin() % 8 == origin % 8)   same_file = true;
+            if (other.origin() / 8 == origin / 8)   same_rank = true;
+        }
+        if (ambiguous && (!same_file || same_rank)) san += (char)('a' + origin % 8);
+        if (ambiguous && same_file)                 san += (char)('1' + origin / 8);
+    }
+    if (capture)    san += 'x';
+    san += integer_to_chess_notation(destination);
+    if (move.flag() == PROMOTION)
+    {
+        san += '=';
+        san += "NBRQ"[move.promotion() - KNIGHT];
+    }
+
+    board.make_move(move, history);
+    if (check_for_check(&board, board.side_to_move == WHITE))   san += has_legal_move(board) ? "+" : "#";
+    board.unmake_move(history);
+    return san;
+
+}
+
+// parse_san() strips check marks and annotations, then reads the piece, any origin file or rank, the destination and any promotion.
+MoveError parse_san(const Board & board, const std::string & text, Move & move) {
+
+    std::string san = text;
+    while (!san.empty() && std::string("+#!?").find(san.back()) != std::string::npos)    san.pop_back();
+    if (san.compare(0, 3, "O-O") == 0 || san.compare(0, 3, "0-0") == 0) return CASTLING_NOT_SUPPORTED;
+
+    int type = PAWN;
+    size_t piece = std::string("NBRQK").find(san.empty() ? ' ' : san[0]);
+    if (piece != std::string::npos)
+    {
+        type = KNIGHT + (int)piece;
+        san.erase(0, 1);
+    }
+    int promotion = -1;
+    size_t equals = san.find('=');
+    if (equals != std::string::npos)
+    {
+        if (equals + 2 != san.size())   return BAD_NOTATION;
+        san.erase(equals, 1);
+    }
+    if (type == PAWN && san.size() >= 3 && std::string("NBRQ").find(san.back()) != std::string::npos)
+    {
+        promotion = KNIGHT + (int)std::string("NBRQ").find(san.back());
+        san.pop_back();
+    }
+    san.erase(std::remove(san.begin(), san.end(), 'x'), san.end());
+
+    // What is left is the destination square, after an optional origin file and rank to tell apart pieces that could both move there.
+    if (san.size() < 2 || san.size() > 4)   return BAD_NOTATION;
+    std::string square = san.substr(san.size() - 2);
+    if (square[0] < 'a' || square[0] > 'h' || square[1] < '1' || square[1] > '8')  return BAD_NOTATION;
+    int destination = chess_notation_to_integer(square);
+    int file = -1, rank = -1;
+    for (size_t i = 0 ; i + 2 < san.size() ; i++)
+    {
+        if (san[i] >= 'a' && san[i] <= 'h')         file = san[i] - 'a';
+        else if (san[i] >= '1' && san[i] <= '8')    rank = san[i] - '1';
+        else    return BAD_NOTATION;
+    }
+    // A pawn capture always names the file the pawn came from.
+    if (type == PAWN && file < 0)   file = destination % 8;
+
+    // Every piece that fits is put through validate_move(), so a move that isn't legal fails for the same reason a typed one would.
+    int found = 0;
+    MoveError error = CANNOT_MOVE_THERE;
+    Bitboard candidates = board.pieces[board.side_to_move][type];
+    while (candidates)
+    {
+        int origin = pop_lowest_square(candidates);
+        if ((file >= 0 && origin % 8 != file) || (rank >= 0 && origin / 8 != rank))   continue;
+        Move candidate(origin, destination);
+        if (promotion >= 0)     candidate = Move(origin, destination, PROMOTION, promotion);
+        else if (type == PAWN && destination == board.en_passant_square)    candidate = Move(origin, destination, EN_PASSANT);
+        MoveError result = validate_move(board, candidate);
+        if (result == MOVE_OK)
+        {
+            move = candidate;
+            found++;
+        }
+        else if (error == CANNOT_MOVE_THERE)    error = result;
+    }
+    if (found > 1)  return AMBIGUOUS_MOVE;
+    return found == 1 ? MOVE_OK : error;
+
+}
+
+// validate_move() checks a move against each rule in the order a player would think of them, so the error returned is the most
+// useful one. Anything that passes every piece rule but isn't among the legal moves must leave the mover's king in check.
+MoveError validate_move(const Board & board, Move move) {
+
+    LegalMoves legal;
+    legal.compute(board);
+    return validate_move(board, legal, move);
+
+}
+
+void LegalMoves::compute(const Board & board) {
+
+    MoveList list;
+    generate_legal_moves(board, list);
+    for (Bitboard & b : targets)    b = 0;
+    for (Move m : list)             targets[m.origin()] |= square_bit(m.destination());
+
+}
+
+// The piece rules are checked first, as before. Promotion and en passant flags are settled by them, so whether a move is legal
+// only depends on its two squares, and one bit of the matrix answers it.
+MoveError validate_move(const Board & board, const LegalMoves & legal, Move move) {
+
+    int us = board.side_to_move;
+    int them = !us;
+    int origin = move.origin();
+    int destination = move.destination();
+    if (origin == destination)                          return SAME_SQUARE;
+    if (board.is_empty(origin))                         return NO_PIECE_AT_ORIGIN;
+    if (board.color_at(origin) != us)                   return NOT_YOUR_PIECE;
+    if (board.is_empty(destination))
+    {
+        if (!board.can_move(origin, destination))       return CANNOT_MOVE_THERE;
+    }
+    else if (board.color_at(destination) == us)         return OWN_PIECE_AT_DESTINATION;
+    else if (!board.can_capture(origin, destination))   return CANNOT_CAPTURE_THERE;
+
+    bool pawn = board.type_at(origin) == PAWN;
+    bool promotes = pawn && (destination / 8 == 0 || destination / 8 == 7);
+    if (promotes && move.flag() != PROMOTION)           return PROMOTION_REQUIRED;
+    if (!promotes && move.flag() == PROMOTION)          return NOT_A_PROMOTION;
+    // A pawn moving diagonally onto an empty square is taking en passant, and the move has to say so to be played correctly.
+    bool en_passant = pawn && board.is_empty(destination) && destination % 8 != origin % 8;
+    if (en_passant != (move.flag() == EN_PASSANT))      return CANNOT_MOVE_THERE;
+    if (legal.contains(origin, destination))            return MOVE_OK;
+
+    // A king move that keeps to the piece rules can only be illegal because the destination is attacked.
+    int king = board.king_square[us];
+    if (origin == king)                                 return KING_WOULD_BE_IN_CHECK;
+    // A piece is pinned if it is the only thing between its king and an enemy slider on the same line, and may only move along it.
+    Bitboard occupancy = board.all_pieces();
+    Bitboard snipers = (rook_attacks(king, 0) & (board.pieces[them][ROOK] | board.pieces[them][QUEEN]))
+                     | (bishop_attacks(king, 0) & (board.pieces[them][BISHOP] | board.pieces[them][QUEEN]));
+    while (snipers)
+    {
+        Bitboard blockers = between_squares[king][pop_lowest_square(snipers)] & occupancy;
+        if (blockers == square_bit(origin) && !(line_through[king][origin] & square_bit(destination)))  return PINNED_PIECE;
+    }
+    return LEAVES_KING_IN_CHECK;
+
+}
+
+MoveError apply_move(Board & board, Move move, UndoStack & history) {
+
+    MoveError error = validate_move(board, move);
+    if (error == MOVE_OK)   board.make_move(move, history);
+    return error;
+
+}
+
+const char * move_error_message(MoveError error) {
+
+    switch (error)
+    {
+        case MOVE_OK:                   return "";
+        case BAD_NOTATION:              return "Enter piece locations as \"A1\", \"E4\", etc.";
+        case SAME_SQUARE:               return "Origin square and destination square must be distinct.";
+        case NO_PIECE_AT_ORIGIN:        return "The origin square must contain a piece.";
+        case NOT_YOUR_PIECE:            return "The origin square must contain a piece of your color.";
+        case CANNOT_MOVE_THERE:         return "That piece cannot be moved to the designated destination square.";
+        case OWN_PIECE_AT_DESTINATION:  return "The destination square cannot contain one of your own pieces.";
+        case CANNOT_CAPTURE_THERE:      return "That piece can't capture like that.";
+        case PROMOTION_REQUIRED:        return "A pawn reaching the last rank must be promoted.";
+        case NOT_A_PROMOTION:           return "Only a pawn reaching the last rank can be promoted.";
+        case LEAVES_KING_IN_CHECK:      return "You can't end your turn in check.";
+        case KING_WOULD_BE_IN_CHECK:    return "Your king would be in check on that square.";
+        case PINNED_PIECE:              return "That piece is pinned to your king, so it can only move along the line of the pin.";
+        case AMBIGUOUS_MOVE:            return "More than one piece can make that move.";
+        case CASTLING_NOT_SUPPORTED:    return "Castling isn't supported yet.";
+    }
+    return "";
+
+}
+
+// The transposition table shared by every search.
+TranspositionTable transposition_table;
+
+// Pawn structure scores in centipawns, for the middlegame and the endgame. Passed pawns earn more the further they have
+// advanced, by rank counted from their own side.
+const int passed_mg [8] = {0, 5, 10, 15, 25, 40, 60, 0};
+const int passed_eg [8] = {0, 10, 15, 25, 45, 70, 100, 0};
+const int doubled_mg = 10, doubled_eg = 20;
+const int isolated_mg = 10, isolated_eg = 15;
+const int backward_mg = 8, backward_eg = 12;
+
+void score_pawns(const Board & board, PawnEntry & entry) {
+
+    int mg = 0, eg = 0;
+    for (int color = WHITE ; color <= BLACK ; color++)
+    {
+        int sign = color == WHITE ? 1 : -1;
+        Bitboard ours = board.pieces[color][PAWN];
+        Bitboard theirs = board.pieces[!color][PAWN];
+        entry.files[color] = 0;
+        entry.passed[color] = 0;
+        for (Bitboard b = ours ; b ; )
+        {
+            int square = pop_lowest_square(b);
+            int rank = color == WHITE ? square / 8 : 7 - square / 8;
+            entry.files[color] |= 1 << (square % 8);
+            if (!(passed_span[color][square] & theirs))
+            {
+                entry.passed[color] |= square_bit(square);
+                mg += sign * passed_mg[rank];
+                eg += sign * passed_eg[rank];
+            }
+            // Only the pawn behind is counted as doubled, so a pair costs one penalty.
+            if (forward_span[color][square] & ours)
+            {
+                mg -= sign * doubled_mg;
+                eg -= sign * doubled_eg;
+            }
+            // A pawn that no pawn beside it can ever guard is isolated. One whose neighbours have all gone past it, and that can't
+            // step forward without being taken by a pawn, is backward.
+            if (!(adjacent_files[square % 8] & ours))
+            {
+                mg -= sign * isolated_mg;
+                eg -= sign * isolated_eg;
+            }
+            else if (!(support_span[color][square] & ours) && (pawn_attacks[color][square + 8 * sign] & theirs))
+            {
+                mg -= sign * backward_mg;
+                eg -= sign * backward_eg;
+            }
+        }
+    }
+    entry.mg = mg;
+    entry.eg = eg;
+    entry.key = board.pawn_key;
+
+}
+
+// evaluate() blends the middlegame and endgame scores kept on the board, plus the pawn structure terms, by the material other
+// than pawns that is left.
+int evaluate(const Board & board, PawnTable * pawns) {
+
+    PawnEntry scratch;
+    if (!pawns) score_pawns(board, scratch);
+    const PawnEntry & structure = pawns ? pawns->probe(board) : scratch;
+    int mg = board.mg_score + structure.mg;
+    int eg = board.eg_score + structure.eg;
+    int phase = std::min(board.material[WHITE] + board.material[BLACK], OPENING_MATERIAL);
+    int score = (mg * phase + eg * (OPENING_MATERIAL - phase)) / OPENING_MATERIAL;
+    return board.side_to_move == WHITE ? score : -score;
+
+}
+
+// is_capture() returns true if the move takes a piece.
+bool is_capture(const Board & board, Move m) {
+    return !board.is_empty(m.destination()) || m.flag() == EN_PASSANT;
+}
+
+// Mate scores are stored in the transposition table relative to the position rather than the root, so they stay right when the position is reached at another ply.
+int score_to_tt(int score, int ply)     {return score >= MATE_BOUND ? score + ply : score <= -MATE_BOUND ? score - ply : score;}
+int score_from_tt(int score, int ply)   {return score >= MATE_BOUND ? score - ply : score <= -MATE_BOUND ? score + ply : score;}
+
+// score_to_string() writes a score the way UCI does: "cp <centipawns>", or "mate <moves>" with a negative count when the side to move is getting mated.
+std::string score_to_string(int score) {
+    if (std::abs(score) < MATE_BOUND)   return "cp " + std::to_string(score);
+    int plies = MATE_SCORE - std::abs(score);
+    return "mate " + std::to_string(score > 0 ? (plies + 1) / 2 : -(plies / 2));
+}
+
+// Lazy SMP helpers skip some iterations so that they spread out over different depths. Helper i skips depth d when
+// (d + skip_phase[i]) / skip_size[i] is odd, with i counted from the first helper and wrapping after twenty.
+const int skip_size [20] =  {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+const int skip_phase [20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+// run() searches until a limit is reached or stop is set, and returns the best move found.
+Move Search::run()
+{
+    start = std::chrono::steady_clock::now();
+    table->new_search();
+
+    helpers.clear();
+    std::vector <std::thread> threads;
+    for (int i = 1 ; i < limits.threads ; i++)
+    {
+        helpers.emplace_back(new Search(board, history, limits));
+        Search & helper = *helpers.back();
+        helper.id = i;
+        helper.stop_flag = &stop;
+        helper.start = start;
+        helper.report = nullptr;
+        helper.table = table;
+        threads.emplace_back(&Search::iterate, &helper);
+    }
+
+    iterate();
+    stop = true;
+    for (std::thread & thread : threads)    thread.join();
+
+    // A helper that got further than the main worker knows more about the position, so its move is played instead.
+    for (auto & helper : helpers)
+    {
+        if (helper->completed_depth <= completed_depth) continue;
+        best_move = helper->best_move;
+        best_score = helper->best_score;
+        completed_depth = helper->completed_depth;
+        pv_length = helper->pv_length;
+        for (int i = 0 ; i < pv_length ; i++)   pv[i] = helper->pv[i];
+    }
+    return best_move;
+}
+
+// iterate() deepens one ply at a time until a limit is reached or the stop flag is set.
+void Search::iterate()
+{
+    for (int depth = 1 ; depth <= limits.depth && depth < MAX_DEPTH ; depth++)
+    {
+        if (id > 0 && ((depth + skip_phase[(id - 1) % 20]) / skip_size[(id - 1) % 20]) % 2)   continue;
+        int score = alpha_beta(-INFINITE_SCORE, INFINITE_SCORE, depth, 0);
+        if (stopped())  break;
+        best_score = score;
+        completed_depth = depth;
+        pv_length = pv_lengths[0];
+        for (int i = 0 ; i < pv_length ; i++)   pv[i] = pv_table[0][i];
+        if (pv_length > 0)  best_move = pv[0];
+        if (report) report(*this);
+        if (*stop_flag) break;
+        // Don't start another iteration once a forced mate has been found.
+        if (std::abs(score) >= MATE_BOUND)  break;
+    }
+}
+
+// is_draw() returns true if the position is drawn by the 50 move rule or repeats an earlier one.
+// Only positions since the last capture or pawn move, with the same side to move, can be repeats.
+bool Search::is_draw() const
+{
+    if (board.halfmove_clock >= 100)    return true;
+    int oldest = std::max(history.size - board.halfmove_clock, 0);
+    for (int i = history.size - 2 ; i >= oldest ; i -= 2)
+    {
+        if (history.records[i].key == board.key)    return true;
+    }
+    return false;
+}
+
+// score_moves() gives each move an ordering score: the transposition table move, then captures by
+// most valuable victim and least valuable attacker, then killer moves, then quiet moves by history.
+void Search::score_moves(MoveList & list, int * scores, Move tt_move, int ply) const
+{
+    for (int i = 0 ; i < list.size ; i++)
+    {
+        Move m = list.moves[i];
+        if (m == tt_move)                                   scores[i] = 1 << 30;
+        else if (is_capture(board, m) || m.flag() == PROMOTION)
+        {
+            int victim = m.flag() == EN_PASSANT ? PAWN : board.type_at(m.destination());
+            int gain = (victim == NO_PIECE ? 0 : piece_values[victim]) + (m.flag() == PROMOTION ? piece_values[m.promotion()] : 0);
+            scores[i] = (1 << 24) + 16 * gain - board.type_at(m.origin());
+        }
+        else if (m == killers[ply][0])                      scores[i] = (1 << 23) + 1;
+        else if (m == killers[ply][1])                      scores[i] = 1 << 23;
+        else    scores[i] = history_scores[board.side_to_move][m.origin()][m.destination()];
+    }
+}
+
+// pick_move() swaps the best scored move left in the list into position i, so moves are sorted only as far as they are searched.
+void Search::pick_move(MoveList & list, int * scores, int i)
+{
+    int best = i;
+    for (int j = i + 1 ; j < list.size ; j++)
+    {
+        if (scores[j] > scores[best])   best = j;
+    }
+    std::swap(list.moves[i], list.moves[best]);
+    std::swap(scores[i], scores[best]);
+}
+
+// quiescence() searches only captures and promotions until the position is quiet, so the evaluation is never taken in the middle of an exchange.
+int Search::quiescence(int alpha, int beta, int ply)
+{
+    pv_lengths[ply] = 0;
+    if (ply >= MAX_DEPTH - 1)   return evaluate(board, pawns.get());
+    count_node();
+    check_limits();
+    if (stopped())  return 0;
+
+    bool in_check = check_for_check(&board, board.side_to_move == WHITE);
+    MoveList list;
+    if (in_check)
+    {
+        // In check every evasion is searched, and having none is mate.
+        generate_legal_moves(board, list);
+        if (list.size == 0)     return -MATE_SCORE + ply;
+    }
+    else
+    {
+        int stand_pat = evaluate(board, pawns.get());
+        if (stand_pat >= beta)  return stand_pat;
+        alpha = std::max(alpha, stand_pat);
+        generate_legal_captures(board, list);
+    }
+
+    int scores [MAX_MOVES];
+    score_moves(list, scores, Move(), ply);
+    int best = in_check ? -INFINITE_SCORE : alpha;
+    for (int i = 0 ; i < list.size ; i++)
+    {
+        pick_move(list, scores, i);
+        board.make_move(list.moves[i], history);
+        int score = -quiescence(-beta, -alpha, ply + 1);
+        board.unmake_move(history);
+        if (stopped())  return 0;
+        if (score > best)
+        {
+            best = score;
+            if (score > alpha)  alpha = score;
+            if (score >= beta)  break;
+        }
+    }
+    return best;
+}
+
+// alpha_beta() is the main negamax search. It returns the score of the position to the given depth, within the alpha-beta window.
+int Search::alpha_beta(int alpha, int beta, int depth, int ply)
+{
+    pv_lengths[ply] = 0;
+    if (ply > 0 && is_draw())   return 0;
+    if (depth <= 0 || ply >= MAX_DEPTH - 1) return quiescence(alpha, beta, ply);
+
+    count_node();
+    check_limits();
+    if (stopped())  return 0;
+
+    // A position in a tablebase needs no search. Its mates are scored just like those the search finds.
+    int wdl, dtm;
+    if (ply > 0 && tablebases.probe(board, wdl, dtm))  return wdl == 0 ? 0 : wdl * (MATE_SCORE - ply - dtm);
+
+    Move tt_move;
+    TTEntry entry;
+    if (table->probe(board.key, entry))
+    {
+        tt_move = entry.move;
+        int score = score_from_tt(entry.score, ply);
+        if (ply > 0 && entry.depth >= depth)
+        {
+            if (entry.bound == BOUND_EXACT)                         return score;
+            if (entry.bound == BOUND_LOWER && score >= beta)        return score;
+            if (entry.bound == BOUND_UPPER && score <= alpha)       return score;
+        }
+    }
+    // At the root, the best move of the last iteration goes first even if the table lost it.
+    if (ply == 0 && best_move != Move())    tt_move = best_move;
+
+    MoveList list;
+    generate_legal_moves(board, list);
+    bool in_check = check_for_check(&board, board.side_to_move == WHITE);
+    if (list.size == 0)     return in_check ? -MATE_SCORE + ply : 0;
+    // Look one ply further when in check, so forcing sequences aren't cut off halfway.
+    if (in_check)   depth++;
+
+    int scores [MAX_MOVES];
+    score_moves(list, scores, tt_move, ply);
+    int original_alpha = alpha;
+    int best = -INFINITE_SCORE;
+    Move best_here;
+    for (int i = 0 ; i < list.size ; i++)
+    {
+        pick_move(list, scores, i);
+        Move m = list.moves[i];
+        bool quiet = !is_capture(board, m) && m.flag() != PROMOTION;
+
+        board.make_move(m, history);
+        int score = -alpha_beta(-beta, -alpha, depth - 1, ply + 1);
+        board.unmake_move(history);
+        if (stopped())  return 0;
+
+        if (score > best)
+        {
+            best = score;
+            best_here = m;
+            if (score > alpha)
+            {
+                alpha = score;
+                pv_table[ply][0] = m;
+                for (int j = 0 ; j < pv_lengths[ply + 1] ; j++)  pv_table[ply][j + 1] = pv_table[ply + 1][j];
+                pv_lengths[ply] = pv_lengths[ply + 1] + 1;
+            }
+            if (score >= beta)
+            {
+                if (quiet)
+                {
+                    if (killers[ply][0] != m)
+                    {
+                        killers[ply][1] = killers[ply][0];
+                        killers[ply][0] = m;
+                    }
+                    int & h = history_scores[board.side_to_move][m.origin()][m.destination()];
+                    h += depth * depth;
+                    // Keep history scores below the killer and capture scores.
+                    if (h > (1 << 22))  age_history();
+                }
+                break;
+            }
+        }
+    }
+
+    int bound = best >= beta ? BOUND_LOWER : best > original_alpha ? BOUND_EXACT : BOUND_UPPER;
+    table->store(board.key, best_here, score_to_tt(best, ply), depth, bound);
+    return best;
+}
+
+// age_history() halves every history score.
+void Search::age_history()
+{
+    for (auto & side : history_scores)
+    {
+        for (auto & origin : side)
+        {
+            for (int & h : origin)  h /= 2;
+        }
+    }
+}
+
+
+// Journal numbers are stored little-endian whatever the machine, one byte at a time.
+static void put_le(unsigned char * bytes, uint64_t value, int size)
+{
+    for (int i = 0 ; i < size ; i++)    bytes[i] = (unsigned char)(value >> (8 * i));
+}
+
+static uint64_t get_le(const unsigned char * bytes, int size)
+{
+    uint64_t value = 0;
+    for (int i = size - 1 ; i >= 0 ; i--)   value = (value << 8) | bytes[i];
+    return value;
+}
+
+// write_all() writes the whole buffer at offset, retrying short writes.
+static bool write_all(int fd, const unsigned char * bytes, size_t size, off_t offset)
+{
+    while (size > 0)
+    {
+        ssize_t written = ::pwrite(fd, bytes, size, offset);
+        if (written <= 0)   return false;
+        bytes += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+bool GameJournal::create(const std::string & path, const Board & start, const std::string & start_fen, const UndoStack & history)
+{
+    close();
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    std::vector <unsigned char> bytes(JOURNAL_HEADER_SIZE + start_fen.size() + 2 * history.size, 0);
+    std::memcpy(bytes.data(), "TCJ1", 4);
+    put_le(&bytes[6], start_fen.size(), 2);
+    put_le(&bytes[8], start.key, 8);
+    put_le(&bytes[16], history.size, 4);
+    std::memcpy(&bytes[JOURNAL_HEADER_SIZE], start_fen.data(), start_fen.size());
+    for (int i = 0 ; i < history.size ; i++)    put_le(&bytes[JOURNAL_HEADER_SIZE + start_fen.size() + 2 * i], history.records[i].move.data, 2);
+
+    move_count = history.size;
+    unsynced = 0;
+    result = RESULT_NONE;
+    end = bytes.size();
+    if (write_all(fd, bytes.data(), bytes.size(), 0) && ::fsync(fd) == 0)  return true;
+    close();
+    return false;
+}
+
+bool GameJournal::reopen(const std::string & path, const JournalHeader & header)
+{
+    close();
+    // Not O_APPEND, since Linux would then send the header updates in sync() to the end of the file as well.
+    fd = ::open(path.c_str(), O_WRONLY);
+    if (fd < 0) return false;
+    // A torn entry at the end would shift every later one, so the file is cut back to a whole number of entries first.
+    off_t size = ::lseek(fd, 0, SEEK_END);
+    off_t entries_start = JOURNAL_HEADER_SIZE + header.start_fen.size();
+    end = size - (size - entries_start) % 2;
+    if (size < entries_start || ::ftruncate(fd, end) != 0)
+    {
+        close();
+        return false;
+    }
+    move_count = header.move_count;
+    unsynced = 0;
+    result = header.result;
+    return true;
+}
+
+bool GameJournal::append(Move m)
+{
+    if (fd < 0) return false;
+    move_count++;
+    return write_entry(m.data);
+}
+
+bool GameJournal::append_undo()
+{
+    if (fd < 0 || move_count == 0)  return false;
+    move_count--;
+    return write_entry(0);
+}
+
+bool GameJournal::write_entry(uint16_t entry)
+{
+    unsigned char bytes [2];
+    put_le(bytes, entry, 2);
+    if (!write_all(fd, bytes, 2, end))  return false;
+    end += 2;
+    if (++unsynced >= JOURNAL_SYNC_INTERVAL)    return sync();
+    return true;
+}
+
+// sync() writes the result and move count into the header and flushes the journal to disk.
+bool GameJournal::sync()
+{
+    unsigned char result_byte = result;
+    unsigned char count [4];
+    put_le(count, move_count, 4);
+    unsynced = 0;
+    return write_all(fd, &result_byte, 1, 4) && write_all(fd, count, 4, 16) && ::fsync(fd) == 0;
+}
+
+bool GameJournal::finish(GameResult game_result)
+{
+    if (fd < 0) return false;
+    result = game_result;
+    bool ok = sync();
+    ::close(fd);
+    fd = -1;
+    return ok;
+}
+
+void GameJournal::close()
+{
+    if (fd < 0) return;
+    sync();
+    ::close(fd);
+    fd = -1;
+}
+
+bool read_journal(const std::string & path, Board & board, UndoStack & history, JournalHeader & header, std::string & error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        error = "the journal can't be opened";
+        return false;
+    }
+    std::vector <unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (bytes.size() < (size_t)JOURNAL_HEADER_SIZE || std::memcmp(bytes.data(), "TCJ1", 4) != 0)
+    {
+        error = "the file isn't a journal";
+        return false;
+    }
+
+    header.result = (GameResult)bytes[4];
+    size_t fen_length = get_le(&bytes[6], 2);
+    header.start_key = get_le(&bytes[8], 8);
+    if (header.result > DRAW || bytes.size() < JOURNAL_HEADER_SIZE + fen_length)
+    {
+        error = "the journal header is damaged";
+        return false;
+    }
+    header.start_fen.assign((const char *)&bytes[JOURNAL_HEADER_SIZE], fen_length);
+
+    std::string reason;
+    board = Board();
+    history.size = 0;
+    if (fen_length > 0 && !board.from_fen(header.start_fen, &reason))
+    {
+        error = "the start position isn't valid, because " + reason;
+        return false;
+    }
+    if (board.key != header.start_key)
+    {
+        error = "the start position doesn't match its key";
+        return false;
+    }
+
+    size_t entries = (bytes.size() - JOURNAL_HEADER_SIZE - fen_length) / 2;
+    for (size_t i = 0 ; i < entries ; i++)
+    {
+        Move m;
+        m.data = (uint16_t)get_le(&bytes[JOURNAL_HEADER_SIZE + fen_length + 2 * i], 2);
+        if (m == Move() && !history.empty())
+        {
+            board.unmake_move(history);
+            continue;
+        }
+        if (history.size >= MAX_PLIES - MAX_DEPTH || validate_move(board, m) != MOVE_OK)
+        {
+            error = "entry " + std::to_string(i + 1) + " isn't a legal move";
+            return false;
+        }
+        board.make_move(m, history);
+    }
+    header.move_count = history.size;
+    return true;
+}
+
+// map_file() maps the whole file at path read-only into memory. It returns false, with a reason in error that names what the file
+// should be, if it can't be opened or mapped, or is shorter than minimum bytes. An empty file maps to no data at all.
+static bool map_file(const std::string & path, size_t minimum, const std::string & what, const unsigned char * & data, size_t & size, std::string & error)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        error = "the " + what + " can't be opened";
+        return false;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || (size_t)info.st_size < minimum)
+    {
+        ::close(fd);
+        error = "the file isn't a " + what;
+        return false;
+    }
+    data = nullptr;
+    size = info.st_size;
+    void * map = size ? ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : nullptr;
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+        error = "the " + what + " can't be mapped into memory";
+        size = 0;
+        return false;
+    }
+    data = (const unsigned char *)map;
+    return true;
+}
+
+bool write_game_database(const std::string & path, const std::vector <GameRecord> & games, std::string & error)
+{
+    std::vector <PositionEntry> index;
+    std::vector <uint64_t> offsets;
+    std::vector <unsigned char> records;
+    std::unique_ptr <UndoStack> history(new UndoStack());
+
+    for (size_t g = 0 ; g < games.size() ; g++)
+    {
+        const GameRecord & record = games[g];
+        Board board;
+        history->size = 0;
+        std::string reason;
+        if (!record.start_fen.empty() && !board.from_fen(record.start_fen, &reason))
+        {
+            error = "game " + std::to_string(g + 1) + " has a bad start position, because " + reason;
+            return false;
+        }
+        if (record.moves.size() > 0xFFFF || record.start_fen.size() > 0xFFFF)
+        {
+            error = "game " + std::to_string(g + 1) + " is too long";
+            return false;
+        }
+
+        offsets.push_back(DATABASE_HEADER_SIZE + records.size());
+        unsigned char game_header [8];
+        uint16_t fen_length = record.start_fen.size();
+        uint32_t move_count = record.moves.size();
+        std::string name = record.name.substr(0, 255);
+        game_header[0] = record.result;
+        game_header[1] = name.size();
+        std::memcpy(&game_header[2], &fen_length, 2);
+        std::memcpy(&game_header[4], &move_count, 4);
+        records.insert(records.end(), game_header, game_header + 8);
+        records.insert(records.end(), name.begin(), name.end());
+        records.insert(records.end(), record.start_fen.begin(), record.start_fen.end());
+
+        for (size_t ply = 0 ; ply <= record.moves.size() ; ply++)
+        {
+            Move next = ply < record.moves.size() ? record.moves[ply] : Move();
+            index.push_back({board.key, (uint32_t)g, (uint16_t)ply, next.data});
+            if (ply == record.moves.size()) break;
+            if (history->size >= MAX_PLIES - MAX_DEPTH || validate_move(board, next) != MOVE_OK)
+            {
+                error = "game " + std::to_string(g + 1) + " has an illegal move at ply " + std::to_string(ply + 1);
+                return false;
+            }
+            board.make_move(next, *history);
+            records.insert(records.end(), (const unsigned char *)&next.data, (const unsigned char *)&next.data + 2);
+        }
+    }
+
+    std::sort(index.begin(), index.end(), [](const PositionEntry & a, const PositionEntry & b)
+    {
+        if (a.key != b.key)     return a.key < b.key;
+        if (a.game != b.game)   return a.game < b.game;
+        return a.ply < b.ply;
+    });
+
+    // The offset table and the index are 8-byte aligned, so the map can be read through them directly.
+    while (records.size() % 8)  records.push_back(0);
+    uint64_t header [8] = {};
+    std::memcpy(header, "TCDB", 4);
+    uint32_t byte_order = 0x01020304;
+    std::memcpy((unsigned char *)header + 4, &byte_order, 4);
+    header[1] = games.size();
+    header[2] = DATABASE_HEADER_SIZE + records.size();
+    header[3] = index.size();
+    header[4] = header[2] + 8 * offsets.size();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write((const char *)header, sizeof(header));
+    file.write((const char *)records.data(), records.size());
+    file.write((const char *)offsets.data(), 8 * offsets.size());
+    file.write((const char *)index.data(), sizeof(PositionEntry) * index.size());
+    file.close();
+    if (file.fail())
+    {
+        error = "the database file can't be written";
+        return false;
+    }
+    return true;
+}
+
+bool GameDatabase::open(const std::string & path, std::string & error)
+{
+    close();
+    if (!map_file(path, DATABASE_HEADER_SIZE, "game database", data, size, error))  return false;
+
+    uint64_t header [8];
+    uint32_t byte_order;
+    std::memcpy(header, data, sizeof(header));
+    std::memcpy(&byte_order, data + 4, 4);
+    if (std::memcmp(data, "TCDB", 4) != 0 || byte_order != 0x01020304)
+    {
+        close();
+        error = "the file isn't a game database written on this kind of machine";
+        return false;
+    }
+    games = header[1];
+    entries = header[3];
+    // Every table must lie inside the file, checked without overflow, before anything is read through it.
+    if (header[2] % 8 || header[4] % 8 || header[2] < DATABASE_HEADER_SIZE || header[2] > size || games > (size - header[2]) / 8
+        || header[4] > size || entries > (size - header[4]) / sizeof(PositionEntry))
+    {
+        close();
+        error = "the database is damaged";
+        return false;
+    }
+    offsets = (const uint64_t *)(data + header[2]);
+    index = (const PositionEntry *)(data + header[4]);
+    for (uint64_t g = 0 ; g < games ; g++)
+    {
+        if (offsets[g] < DATABASE_HEADER_SIZE || offsets[g] > header[2] - 8)
+        {
+            close();
+            error = "the database is damaged";
+            return false;
+        }
+    }
+    return true;
+}
+
+void GameDatabase::close()
+{
+    if (data)   ::munmap((void *)data, size);
+    data = nullptr;
+    size = 0;
+    games = entries = 0;
+    offsets = nullptr;
+    index = nullptr;
+}
+
+void GameDatabase::game(uint64_t number, GameRecord & record) const
+{
+    const unsigned char * p = data + offsets[number];
+    uint16_t fen_length;
+    uint32_t move_count;
+    std::memcpy(&fen_length, p + 2, 2);
+    std::memcpy(&move_count, p + 4, 4);
+    // A damaged length is cut short at the end of the games rather than read past it.
+    size_t room = (const unsigned char *)offsets - p - 8;
+    size_t name_length = std::min<size_t>(p[1], room);
+    fen_length = std::min<size_t>(fen_length, room - name_length);
+    move_count = std::min<size_t>(move_count, (room - name_length - fen_length) / 2);
+    const unsigned char * moves = p + 8 + name_length + fen_length;
+
+    record.result = (GameResult)std::min<int>(p[0], DRAW);
+    record.name.assign((const char *)p + 8, name_length);
+    record.start_fen.assign((const char *)p + 8 + name_length, fen_length);
+    record.moves.resize(move_count);
+    for (uint32_t i = 0 ; i < move_count ; i++) std::memcpy(&record.moves[i].data, moves + 2 * i, 2);
+}
+
+std::pair <const PositionEntry *, const PositionEntry *> GameDatabase::find(uint64_t key) const
+{
+    const PositionEntry * first = std::lower_bound(index, index + entries, key, [](const PositionEntry & e, uint64_t k) {return e.key < k;});
+    const PositionEntry * last = std::upper_bound(first, index + entries, key, [](uint64_t k, const PositionEntry & e) {return k < e.key;});
+    return {first, last};
+}
+
+bool PgnReader::next(PgnGame & game)
+{
+    game = PgnGame();
+    bool started = false;
+    int variation_depth = 0;
+    std::string line;
+    while (!pending.empty() || std::getline(input, line))
+    {
+        if (!pending.empty())
+        {
+            line = pending;
+            pending.clear();
+        }
+        else    line_number++;
+        if (!line.empty() && line.back() == '\r')  line.pop_back();
+
+        // A tag pair after the moves of a game without a result belongs to the next game.
+        if (!comment_depth && !line.empty() && line[0] == '[')
+        {
+            if (!game.moves.empty())
+            {
+                pending = line;
+                return true;
+            }
+            if (!started)   game.line = line_number;
+            started = true;
+            size_t quote = line.find('"');
+            size_t end = line.rfind('"');
+            if (quote == std::string::npos || end == quote) continue;
+            std::string name = line.substr(1, line.find_first_of(" \t") - 1);
+            std::string value = line.substr(quote + 1, end - quote - 1);
+            if (name == "FEN")          game.start_fen = value;
+            else if (name == "Result")  game.result = value;
+            else if (name != "SetUp")   game.tags.push_back({name, value});
+            continue;
+        }
+
+        std::string token;
+        for (size_t i = 0 ; i <= line.size() ; i++)
+        {
+            char c = i < line.size() ? line[i] : ' ';
+            if (comment_depth)
+            {
+                if (c == '}')   comment_depth = 0;
+                continue;
+            }
+            if (c == '{' || c == ';' || c == '(' || c == ')' || c == ' ' || c == '\t')
+            {
+                // Move numbers may be written straight onto the move that follows them (i.e. "12.e4" or "12...Nf6").
+                size_t digits = token.find_first_not_of("0123456789");
+                if (digits != std::string::npos && digits > 0 && token[digits] == '.')  token.erase(0, token.find_first_not_of('.', digits));
+                else if (digits == std::string::npos)   token.clear();
+
+                if (!token.empty() && token[0] != '$' && token.find_first_not_of('.') != std::string::npos && variation_depth == 0)
+                {
+                    if (!started)   game.line = line_number;
+                    started = true;
+                    if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*")
+                    {
+                        game.result = token;
+                        pending = line.substr(i);
+                        if (pending.find_first_not_of(" \t") == std::string::npos)  pending.clear();
+                        return true;
+                    }
+                    game.moves.push_back(token);
+                }
+                token.clear();
+                if (c == '{')   comment_depth = 1;
+                if (c == ';')   break;
+                if (c == '(')   variation_depth++;
+                if (c == ')' && variation_depth > 0)    variation_depth--;
+            }
+            else    token += c;
+        }
+    }
+    return started;
+}
+
+void write_pgn_game(std::ostream & output, const PgnGame & game)
+{
+    for (const auto & tag : game.tags)  output << "[" << tag.first << " \"" << tag.second << "\"]\n";
+    if (!game.start_fen.empty())    output << "[SetUp \"1\"]\n[FEN \"" << game.start_fen << "\"]\n";
+    std::string result = game.result.empty() ? "*" : game.result;
+    output << "[Result \"" << result << "\"]\n\n";
+
+    // The start position gives the number of the first move, and whether it is black's.
+    Board board;
+    if (!game.start_fen.empty())    board.from_fen(game.start_fen);
+    int number = board.fullmove_number;
+    bool white = board.side_to_move == WHITE;
+    std::string line;
+    auto add = [&](const std::string & word)
+    {
+        if (!line.empty() && line.size() + 1 + word.size() > 79)
+        {
+            output << line << "\n";
+            line.clear();
+        }
+        line += (line.empty() ? "" : " ") + word;
+    };
+    for (size_t i = 0 ; i < game.moves.size() ; i++)
+    {
+        if (white)          add(std::to_string(number) + ". " + game.moves[i]);
+        else if (i == 0)    add(std::to_string(number) + "... " + game.moves[i]);
+        else                add(game.moves[i]);
+        if (!white) number++;
+        white = !white;
+    }
+    add(result);
+    output << line << "\n\n";
+}
+
+// Polyglot's Random64 table, as published with its book format. The first 768 numbers are for a piece on a square, at
+// 64 * kind + square, where kind runs black pawn, white pawn, black knight, white knight and so on up to white king.
+// Then come 4 for the castling rights, 8 for the en passant file and 1 for white to move.
+// Entries 558 to 763, for queens and kings, are still zero and have to be copied in from the published table. "chess book test"
+// checks the result against the keys published with the format.
+const uint64_t polyglot_random [781] =
+{
+    0x9D39247E33776D41ULL, 0x2AF7398005AAA5C7ULL, 0x44DB015024623547ULL, 0x9C15F73E62A76AE2ULL,
+    0x75834465489C0C89ULL, 0x3290AC3A203001BFULL, 0x0FBBAD1F61042279ULL, 0xE83A908FF2FB60CAULL,
+    0x0D7E765D58755C10ULL, 0x1A083822CEAFE02DULL, 0x9605D5F0E25EC3B0ULL, 0xD021FF5CD13A2ED5ULL,
+    0x40BDF15D4A672E32ULL, 0x011355146FD56395ULL, 0x5DB4832046F3D9E5ULL, 0x239F8B2D7FF719CCULL,
+    0x05D1A1AE85B49AA1ULL, 0x679F848F6E8FC971ULL, 0x7449BBFF801FED0BULL, 0x7D11CDB1C3B7ADF0ULL,
+    0x82C7709E781EB7CCULL, 0xF3218F1C9510786CULL, 0x331478F3AF51BBE6ULL, 0x4BB38DE5E7219443ULL,
+    0xAA649C6EBCFD50FCULL, 0x8DBD98A352AFD40BULL, 0x87D2074B81D79217ULL, 0x19F3C751D3E92AE1ULL,
+    0xB4AB30F062B19ABFULL, 0x7B0500AC42047AC4ULL, 0xC9452CA81A09D85DULL, 0x24AA6C514DA27500ULL,
+    0x4C9F34427501B447ULL, 0x14A68FD73C910841ULL, 0xA71B9B83461CBD93ULL, 0x03488B95B0F1850FULL,
+    0x637B2B34FF93C040ULL, 0x09D1BC9A3DD90A94ULL, 0x3575668334A1DD3BULL, 0x735E2B97A4C45A23ULL,
+    0x18727070F1BD400BULL, 0x1FCBACD259BF02E7ULL, 0xD310A7C2CE9B6555ULL, 0xBF983FE0FE5D8244ULL,
+    0x9F74D14F7454A824ULL, 0x51EBDC4AB9BA3035ULL, 0x5C82C505DB9AB0FAULL, 0xFCF7FE8A3430B241ULL,
+    0x3253A729B9BA3DDEULL, 0x8C74C368081B3075ULL, 0xB9BC6C87167C33E7ULL, 0x7EF48F2B83024E20ULL,
+    0x11D505D4C351BD7FULL, 0x6568FCA92C76A243ULL, 0x4DE0B0F40F32A7B8ULL, 0x96D693460CC37E5DULL,
+    0x42E240CB63689F2FULL, 0x6D2BDCDAE2919661ULL, 0x42880B0236E4D951ULL, 0x5F0F4A5898171BB6ULL,
+    0x39F890F579F92F88ULL, 0x93C5B5F47356388BULL, 0x63DC359D8D231B78ULL, 0xEC16CA8AEA98AD76ULL,
+    0x5355F900C2A82DC7ULL, 0x07FB9F855A997142ULL, 0x5093417AA8A7ED5EULL, 0x7BCBC38DA25A7F3CULL,
+    0x19FC8A768CF4B6D4ULL, 0x637A7780DECFC0D9ULL, 0x8249A47AEE0E41F7ULL, 0x79AD695501E7D1E8ULL,
+    0x14ACBAF4777D5776ULL, 0xF145B6BECCDEA195ULL, 0xDABF2AC8201752FCULL, 0x24C3C94DF9C8D3F6ULL,
+    0xBB6E2924F03912EAULL, 0x0CE26C0B95C980D9ULL, 0xA49CD132BFBF7CC4ULL, 0xE99D662AF4243939ULL,
+    0x27E6AD7891165C3FULL, 0x8535F040B9744FF1ULL, 0x54B3F4FA5F40D873ULL, 0x72B12C32127FED2BULL,
+    0xEE954D3C7B411F47ULL, 0x9A85AC909A24EAA1ULL, 0x70AC4CD9F04F21F5ULL, 0xF9B89D3E99A075C2ULL,
+    0x87B3E2B2B5C907B1ULL, 0xA366E5B8C54F48B8ULL, 0xAE4A9346CC3F7CF2ULL, 0x1920C04D47267BBDULL,
+    0x87BF02C6B49E2AE9ULL, 0x092237AC237F3859ULL, 0xFF07F64EF8ED14D0ULL, 0x8DE8DCA9F03CC54EULL,
+    0x9C1633264DB49C89ULL, 0xB3F22C3D0B0B38EDULL, 0x390E5FB44D01144BULL, 0x5BFEA5B4712768E9ULL,
+    0x1E1032911FA78984ULL, 0x9A74ACB964E78CB3ULL, 0x4F80F7A035DAFB04ULL, 0x6304D09A0B3738C4ULL,
+    0x2171E64683023A08ULL, 0x5B9B63EB9CEFF80CULL, 0x506AACF489889342ULL, 0x1881AFC9A3A701D6ULL,
+    0x6503080440750644ULL, 0xDFD395339CDBF4A7ULL, 0xEF927DBCF00C20F2ULL, 0x7B32F7D1E03680ECULL,
+    0xB9FD7620E7316243ULL, 0x05A7E8A57DB91B77ULL, 0xB5889C6E15630A75ULL, 0x4A750A09CE9573F7ULL,
+    0xCF464CEC899A2F8AULL, 0xF538639CE705B824ULL, 0x3C79A0FF5580EF7FULL, 0xEDE6C87F8477609DULL,
+    0x799E81F05BC93F31ULL, 0x86536B8CF3428A8CULL, 0x97D7374C60087B73ULL, 0xA246637CFF328532ULL,
+    0x043FCAE60CC0EBA0ULL, 0x920E449535DD359EULL, 0x70EB093B15B290CCULL, 0x73A1921916591CBDULL,
+    0x56436C9FE1A1AA8DULL, 0xEFAC4B70633B8F81ULL, 0xBB215798D45DF7AFULL, 0x45F20042F24F1768ULL,
+    0x930F80F4E8EB7462ULL, 0xFF6712FFCFD75EA1ULL, 0xAE623FD67468AA70ULL, 0xDD2C5BC84BC8D8FCULL,
+    0x7EED120D54CF2DD9ULL, 0x22FE545401165F1CULL, 0xC91800E98FB99929ULL, 0x808BD68E6AC10365ULL,
+    0xDEC468145B7605F6ULL, 0x1BEDE3A3AEF53302ULL, 0x43539603D6C55602ULL, 0xAA969B5C691CCB7AULL,
+    0xA87832D392EFEE56ULL, 0x65942C7B3C7E11AEULL, 0xDED2D633CAD004F6ULL, 0x21F08570F420E565ULL,
+    0xB415938D7DA94E3CULL, 0x91B859E59ECB6350ULL, 0x10CFF333E0ED804AULL, 0x28AED140BE0BB7DDULL,
+    0xC5CC1D89724FA456ULL, 0x5648F680F11A2741ULL, 0x2D255069F0B7DAB3ULL, 0x9BC5A38EF729ABD4ULL,
+    0xEF2F054308F6A2BCULL, 0xAF2042F5CC5C2858ULL, 0x480412BAB7F5BE2AULL, 0xAEF3AF4A563DFE43ULL,
+    0x19AFE59AE451497FULL, 0x52593803DFF1E840ULL, 0xF4F076E65F2CE6F0ULL, 0x11379625747D5AF3ULL,
+    0xBCE5D2248682C115ULL, 0x9DA4243DE836994FULL, 0x066F70B33FE09017ULL, 0x4DC4DE189B671A1CULL,
+    0x51039AB7712457C3ULL, 0xC07A3F80C31FB4B4ULL, 0xB46EE9C5E64A6E7CULL, 0xB3819A42ABE61C87ULL,
+    0x21A007933A522A20ULL, 0x2DF16F761598AA4FULL, 0x763C4A1371B368FDULL, 0xF793C46702E086A0ULL,
+    0xD7288E012AEB8D31ULL, 0xDE336A2A4BC1C44BULL, 0x0BF692B38D079F23ULL, 0x2C604A7A177326B3ULL,
+    0x4850E73E03EB6064ULL, 0xCFC447F1E53C8E1BULL, 0xB05CA3F564268D99ULL, 0x9AE182C8BC9474E8ULL,
+    0xA4FC4BD4FC5558CAULL, 0xE755178D58FC4E76ULL, 0x69B97DB1A4C03DFEULL, 0xF9B5B7C4ACC67C96ULL,
+    0xFC6A82D64B8655FBULL, 0x9C684CB6C4D24417ULL, 0x8EC97D2917456ED0ULL, 0x6703DF9D2924E97EULL,
+    0xC547F57E42A7444EULL, 0x78E37644E7CAD29EULL, 0xFE9A44E9362F05FAULL, 0x08BD35CC38336615ULL,
+    0x9315E5EB3A129ACEULL, 0x94061B871E04DF75ULL, 0xDF1D9F9D784BA010ULL, 0x3BBA57B68871B59DULL,
+    0xD2B7ADEEDED1F73FULL, 0xF7A255D83BC373F8ULL, 0xD7F4F2448C0CEB81ULL, 0xD95BE88CD210FFA7ULL,
+    0x336F52F8FF4728E7ULL, 0xA74049DAC312AC71ULL, 0xA2F61BB6E437FDB5ULL, 0x4F2A5CB07F6A35B3ULL,
+    0x87D380BDA5BF7859ULL, 0x16B9F7E06C453A21ULL, 0x7BA2484C8A0FD54EULL, 0xF3A678CAD9A2E38CULL,
+    0x39B0BF7DDE437BA2ULL, 0xFCAF55C1BF8A4424ULL, 0x18FCF680573FA594ULL, 0x4C0563B89F495AC3ULL,
+    0x40E087931A00930DULL, 0x8CFFA9412EB642C1ULL, 0x68CA39053261169FULL, 0x7A1EE967D27579E2ULL,
+    0x9D1D60E5076F5B6FULL, 0x3810E399B6F65BA2ULL, 0x32095B6D4AB5F9B1ULL, 0x35CAB62109DD038AULL,
+    0xA90B24499FCFAFB1ULL, 0x77A225A07CC2C6BDULL, 0x513E5E634C70E331ULL, 0x4361C0CA3F692F12ULL,
+    0xD941ACA44B20A45BULL, 0x528F7C8602C5807BULL, 0x52AB92BEB9613989ULL, 0x9D1DFA2EFC557F73ULL,
+    0x722FF175F572C348ULL, 0x1D1260A51107FE97ULL, 0x7A249A57EC0C9BA2ULL, 0x04208FE9E8F7F2D6ULL,
+    0x5A110C6058B920A0ULL, 0x0CD9A497658A5698ULL, 0x56FD23C8F9715A4CULL, 0x284C847B9D887AAEULL,
+    0x04FEABFBBDB619CBULL, 0x742E1E651C60BA83ULL, 0x9A9632E65904AD3CULL, 0x881B82A13B51B9E2ULL,
+    0x506E6744CD974924ULL, 0xB0183DB56FFC6A79ULL, 0x0ED9B915C66ED37EULL, 0x5E11E86D5873D484ULL,
+    0xF678647E3519AC6EULL, 0x1B85D488D0F20CC5ULL, 0xDAB9FE6525D89021ULL, 0x0D151D86ADB73615ULL,
+    0xA865A54EDCC0F019ULL, 0x93C42566AEF98FFBULL, 0x99E7AFEABE000731ULL, 0x48CBFF086DDF285AULL,
+    0x7F9B6AF1EBF78BAFULL, 0x58627E1A149BBA21ULL, 0x2CD16E2ABD791E33ULL, 0xD363EFF5F0977996ULL,
+    0x0CE2A38C344A6EEDULL, 0x1A804AADB9CFA741ULL, 0x907F30421D78C5DEULL, 0x501F65EDB3034D07ULL,
+    0x37624AE5A48FA6E9ULL, 0x957BAF61700CFF4EULL, 0x3A6C27934E31188AULL, 0xD49503536ABCA345ULL,
+    0x088E049589C432E0ULL, 0xF943AEE7FEBF21B8ULL, 0x6C3B8E3E336139D3ULL, 0x364F6FFA464EE52EULL,
+    0xD60F6DCEDC314222ULL, 0x56963B0DCA418FC0ULL, 0x16F50EDF91E513AFULL, 0xEF1955914B609F93ULL,
+    0x565601C0364E3228ULL, 0xECB53939887E8175ULL, 0xBAC7A9A18531294BULL, 0xB344C470397BBA52ULL,
+    0x65D34954DAF3CEBDULL, 0xB4B81B3FA97511E2ULL, 0xB422061193D6F6A7ULL, 0x071582401C38434DULL,
+    0x7A13F18BBEDC4FF5ULL, 0xBC4097B116C524D2ULL, 0x59B97885E2F2EA28ULL, 0x99170A5DC3115544ULL,
+    0x6F423357E7C6A9F9ULL, 0x325928EE6E6F8794ULL, 0xD0E4366228B03343ULL, 0x565C31F7DE89EA27ULL,
+    0x30F5611484119414ULL, 0xD873DB391292ED4FULL, 0x7BD94E1D8E17DEBCULL, 0xC7D9F16864A76E94ULL,
+    0x947AE053EE56E63CULL, 0xC8C93882F9475F5FULL, 0x3A9BF55BA91F81CAULL, 0xD9A11FBB3D9808E4ULL,
+    0x0FD22063EDC29FCAULL, 0xB3F256D8ACA0B0B9ULL, 0xB03031A8B4516E84ULL, 0x35DD37D5871448AFULL,
+    0xE9F6082B05542E4EULL, 0xEBFAFA33D7254B59ULL, 0x9255ABB50D532280ULL, 0xB9AB4CE57F2D34F3ULL,
+    0x693501D628297551ULL, 0xC62C58F97DD949BFULL, 0xCD454F8F19C5126AULL, 0xBBE83F4ECC2BDECBULL,
+    0xDC842B7E2819E230ULL, 0xBA89142E007503B8ULL, 0xA3BC941D0A5061CBULL, 0xE9F6760E32CD8021ULL,
+    0x09C7E552BC76492FULL, 0x852F54934DA55CC9ULL, 0x8107FCCF064FCF56ULL, 0x098954D51FFF6580ULL,
+    0x23B70EDB1955C4BFULL, 0xC330DE426430F69DULL, 0x4715ED43E8A45C0AULL, 0xA8D7E4DAB780A08DULL,
+    0x0572B974F03CE0BBULL, 0xB57D2E985E1419C7ULL, 0xE8D9ECBE2CF3D73FULL, 0x2FE4B17170E59750ULL,
+    0x11317BA87905E790ULL, 0x7FBF21EC8A1F45ECULL, 0x1725CABFCB045B00ULL, 0x964E915CD5E2B207ULL,
+    0x3E2B8BCBF016D66DULL, 0xBE7444E39328A0ACULL, 0xF85B2B4FBCDE44B7ULL, 0x49353FEA39BA63B1ULL,
+    0x1DD01AAFCD53486AULL, 0x1FCA8A92FD719F85ULL, 0xFC7C95D827357AFAULL, 0x18A6A990C8B35EBDULL,
+    0xCCCB7005C6B9C28DULL, 0x3BDBB92C43B17F26ULL, 0xAA70B5B4F89695A2ULL, 0xE94C39A54A98307FULL,
+    0xB7A0B174CFF6F36EULL, 0xD4DBA84729AF48ADULL, 0x2E18BC1AD9704A68ULL, 0x2DE0966DAF2F8B1CULL,
+    0xB9C11D5B1E43A07EULL, 0x64972D68DEE33360ULL, 0x94628D38D0C20584ULL, 0xDBC0D2B6AB90A559ULL,
+    0xD2733C4335C6A72FULL, 0x7E75D99D94A70F4DULL, 0x6CED1983376FA72BULL, 0x97FCAACBF030BC24ULL,
+    0x7B77497B32503B12ULL, 0x8547EDDFB81CCB94ULL, 0x79999CDFF70902CBULL, 0xCFFE1939438E9B24ULL,
+    0x829626E3892D95D7ULL, 0x92FAE24291F2B3F1ULL, 0x63E22C147B9C3403ULL, 0xC678B6D860284A1CULL,
+    0x5873888850659AE7ULL, 0x0981DCD296A8736DULL, 0x9F65789A6509A440ULL, 0x9FF38FED72E9052FULL,
+    0xE479EE5B9930578CULL, 0xE7F28ECD2D49EECDULL, 0x56C074A581EA17FEULL, 0x5544F7D774B14AEFULL,
+    0x7B3F0195FC6F290FULL, 0x12153635B2C0CF57ULL, 0x7F5126DBBA5E0CA7ULL, 0x7A76956C3EAFB413ULL,
+    0x3D5774A11D31AB39ULL, 0x8A1B083821F40CB4ULL, 0x7B4A38E32537DF62ULL, 0x950113646D1D6E03ULL,
+    0x4DA8979A0041E8A9ULL, 0x3BC36E078F7515D7ULL, 0x5D0A12F27AD310D1ULL, 0x7F9D1A2E1EBE1327ULL,
+    0xDA3A361B1C5157B1ULL, 0xDCDD7D20903D0C25ULL, 0x36833336D068F707ULL, 0xCE68341F79893389ULL,
+    0xAB9090168DD05F34ULL, 0x43954B3252DC25E5ULL, 0xB438C2B67F98E5E9ULL, 0x10DCD78E3851A492ULL,
+    0xDBC27AB5447822BFULL, 0x9B3CDB65F82CA382ULL, 0xB67B7896167B4C84ULL, 0xBFCED1B0048EAC50ULL,
+    0xA9119B60369FFEBDULL, 0x1FFF7AC80904BF45ULL, 0xAC12FB171817EEE7ULL, 0xAF08DA9177DDA93DULL,
+    0x1B0CAB936E65C744ULL, 0xB559EB1D04E5E932ULL, 0xC37B45B3F8D6F2BAULL, 0xC3A9DC228CAAC9E9ULL,
+    0xF3B8B6675A6507FFULL, 0x9FC477DE4ED681DAULL, 0x67378D8ECCEF96CBULL, 0x6DD856D94D259236ULL,
+    0xA319CE15B0B4DB31ULL, 0x073973751F12DD5EULL, 0x8A8E849EB32781A5ULL, 0xE1925C71285279F5ULL,
+    0x74C04BF1790C0EFEULL, 0x4DDA48153C94938AULL, 0x9D266D6A1CC0542CULL, 0x7440FB816508C4FEULL,
+    0x13328503DF48229FULL, 0xD6BF7BAEE43CAC40ULL, 0x4838D65F6EF6748FULL, 0x1E152328F3318DEAULL,
+    0x8F8419A348F296BFULL, 0x72C8834A5957B511ULL, 0xD7A023A73260B45CULL, 0x94EBC8ABCFB56DAEULL,
+    0x9FC10D0F989993E0ULL, 0xDE68A2355B93CAE6ULL, 0xA44CFE79AE538BBEULL, 0x9D1D84FCCE371425ULL,
+    0x51D2B1AB2DDFB636ULL, 0x2FD7E4B9E72CD38CULL, 0x65CA5B96B7552210ULL, 0xDD69A0D8AB3B546DULL,
+    0x604D51B25FBF70E2ULL, 0x73AA8A564FB7AC9EULL, 0x1A8C1E992B941148ULL, 0xAAC40A2703D9BEA0ULL,
+    0x764DBEAE7FA4F3A6ULL, 0x1E99B96E70A9BE8BULL, 0x2C5E9DEB57EF4743ULL, 0x3A938FEE32D29981ULL,
+    0x26E6DB8FFDF5ADFEULL, 0x469356C504EC9F9DULL, 0xC8763C5B08D1908CULL, 0x3F6C6AF859D80055ULL,
+    0x7F7CC39420A3A545ULL, 0x9BFB227EBDF4C5CEULL, 0x89039D79D6FC5C5CULL, 0x8FE88B57305E2AB6ULL,
+    0xA09E8C8C35AB96DEULL, 0xFA7E393983325753ULL, 0xD6B6D0ECC617C699ULL, 0xDFEA21EA9E7557E3ULL,
+    0xB67C1FA481680AF8ULL, 0xCA1E3785A9E724E5ULL, 0x1CFC8BED0D681639ULL, 0xD18D8549D140CAEAULL,
+    0x4ED0FE7E9DC91335ULL, 0xE4DBF0634473F5D2ULL, 0x1761F93A44D5AEFEULL, 0x53898E4C3910DA55ULL,
+    0x734DE8181F6EC39AULL, 0x2680B122BAA28D97ULL, 0x298AF231C85BAFABULL, 0x7983EED3740847D5ULL,
+    0x66C1A2A1A60CD889ULL, 0x9E17E49642A3E4C1ULL, 0xEDB454E7BADC0805ULL, 0x50B704CAB602C329ULL,
+    0x4CC317FB9CDDD023ULL, 0x66B4835D9EAFEA22ULL, 0x219B97E26FFC81BDULL, 0x261E4E4C0A333A9DULL,
+    0x1FE2CCA76517DB90ULL, 0xD7504DFA8816EDBBULL, 0xB9571FA04DC089C8ULL, 0x1DDC0325259B27DEULL,
+    0xCF3F4688801EB9AAULL, 0xF4F5D05C10CAB243ULL, 0x38B6525C21A42B0EULL, 0x36F60E2BA4FA6800ULL,
+    0xEB3593803173E0CEULL, 0x9C4CD6257C5A3603ULL, 0xAF0C317D32ADAA8AULL, 0x258E5A80C7204C4BULL,
+    0x8B889D624D44885DULL, 0xF4D14597E660F855ULL, 0xD4347F66EC8941C3ULL, 0xE699ED85B0DFB40DULL,
+    0x2472F6207C2D0484ULL, 0xC2A1E7B5B459AEB5ULL, 0xAB4F6451CC1D45ECULL, 0x63767572AE3D6174ULL,
+    0xA59E0BD101731A28ULL, 0x116D0016CB948F09ULL, 0x2CF9C8CA052F6E9FULL, 0x0B090A7560A968E3ULL,
+    0xABEEDDB2DDE06FF1ULL, 0x58EFC10B06A2068DULL, 0xC6E57A78FBD986E0ULL, 0x2EAB8CA63CE802D7ULL,
+    0x14A195640116F336ULL, 0x7C0828DD624EC390ULL, 0xD74BBE77E6116AC7ULL, 0x804456AF10F5FB53ULL,
+    0xEBE9EA2ADF4321C7ULL, 0x03219A39EE587A30ULL, 0x49787FEF17AF9924ULL, 0xA1E9300CD8520548ULL,
+    0x5B45E522E4B1B4EFULL, 0xB49C3B3995091A36ULL, 0xD4490AD526F14431ULL, 0x12A8F216AF9418C2ULL,
+    0x001F837CC7350524ULL, 0x1877B51E57A764D5ULL, 0xA2853B80F17F58EEULL, 0x993E1DE72D36D310ULL,
+    0xB3598080CE64A656ULL, 0x252F59CF0D9F04BBULL, 0xD23C8E176D113600ULL, 0x1BDA0492E7E4586EULL,
+    0x21E0BD5026C619BFULL, 0x3B097ADAF088F94EULL, 0x8D14DEDB30BE846EULL, 0xF95CFFA23AF5F6F4ULL,
+    0x3871700761B3F743ULL, 0xCA672B91E9E4FA16ULL, 0x64C8E531BFF53B55ULL, 0x241260ED4AD1E87DULL,
+    0x106C09B972D2E822ULL, 0x7FBA195410E5CA30ULL, 0x7884D9BC6CB569D8ULL, 0x0647DFEDCD894A29ULL,
+    0x63573FF03E224774ULL, 0x4FC8E9560F91B123ULL, 0x1DB956E450275779ULL, 0xB8D91274B9E9D4FBULL,
+    0xA2EBEE47E2FBFCE1ULL, 0xD9F1F30CCD97FB09ULL, 0xEFED53D75FD64E6BULL, 0x2E6D02C36017F67FULL,
+    0xA9AA4D20DB084E9BULL, 0xB64BE8D8B25396C1ULL, 0x70CB6AF7C2D5BCF0ULL, 0x98F076A4F7A2322EULL,
+    0xBF84470805E69B5FULL, 0x94C3251F06F90CF3ULL, 0x3E003E616A6591E9ULL, 0xB925A6CD0421AFF3ULL,
+    0x61BDD1307C66E300ULL, 0xBF8D5108E27E0D48ULL, 0x240AB57A8B888B20ULL, 0xFC87614BAF287E07ULL,
+    0xEF02CDD06FFDB432ULL, 0xA1082C0466DF6C0AULL, 0x8215E577001332C8ULL, 0xD39BB9C3A48DB6CFULL,
+    0x2738259634305C14ULL, 0x61CF4F94C97DF93DULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    0x5FA7867CAF35E149ULL, 0x56986E2EF3ED091BULL, 0x917F1DD5F8886C61ULL, 0xD20D8C88C8FFE65FULL,
+    0x31D71DCE64B2C310ULL, 0xF165B587DF898190ULL, 0xA57E6339DD2CF3A1ULL, 0x1EF6E6DBB1961EC9ULL,
+    0x70CC73D90BC26E24ULL, 0xE21A6B35DF0C3AD7ULL, 0x003A93D8B2806962ULL, 0x1C99DED33CB890A1ULL,
+    0xCF3145DE0ADD4289ULL, 0xD0E4427A5514FB72ULL, 0x77C621CC9FB3A483ULL, 0x67A34DAC4356550BULL,
+    0xF8D626AAAF278509ULL
+};
+
+uint64_t polyglot_key(const Board & board)
+{
+    uint64_t key = 0;
+    for (int color = WHITE ; color <= BLACK ; color++)
+    {
+        for (int type = PAWN ; type <= KING ; type++)
+        {
+            Bitboard pieces = board.pieces[color][type];
+            while (pieces)  key ^= polyglot_random[64 * (2 * type + (color == WHITE)) + pop_lowest_square(pieces)];
+        }
+    }
+    // The board only keeps an en passant square that a pawn of the side to move can capture on, which is when Polyglot counts it.
+    if (board.en_passant_square >= 0)   key ^= polyglot_random[772 + board.en_passant_square % 8];
+    if (board.side_to_move == WHITE)    key ^= polyglot_random[780];
+    return key;
+}
+
+uint64_t book_key(const Board & board)
+{
+    // The table is complete once it gives the start position the key published with the format.
+    static const bool polyglot_complete = polyglot_key(Board()) == 0x463B96181691FC9CULL;
+    return polyglot_complete ? polyglot_key(board) : board.key;
+}
+
+bool write_opening_book(const std::string & path, std::vector <BookEntry> entries, std::string & error)
+{
+    std::sort(entries.begin(), entries.end(), [](const BookEntry & a, const BookEntry & b)
+    {
+        if (a.key != b.key)     return a.key < b.key;
+        return a.weight > b.weight;
+    });
+    std::vector <unsigned char> bytes(BOOK_ENTRY_SIZE * entries.size(), 0);
+    for (size_t i = 0 ; i < entries.size() ; i++)
+    {
+        const BookEntry & entry = entries[i];
+        unsigned char * p = &bytes[BOOK_ENTRY_SIZE * i];
+        int promotion = entry.move.flag() == PROMOTION ? entry.move.promotion() - KNIGHT + 1 : 0;
+        uint16_t move = entry.move.destination() | entry.move.origin() << 6 | promotion << 12;
+        for (int b = 0 ; b < 8 ; b++)   p[b] = entry.key >> (56 - 8 * b);
+        p[8] = move >> 8;
+        p[9] = move;
+        p[10] = entry.weight >> 8;
+        p[11] = entry.weight;
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write((const char *)bytes.data(), bytes.size());
+    file.close();
+    if (file.fail())
+    {
+        error = "the book can't be written";
+        return false;
+    }
+    return true;
+}
+
+bool OpeningBook::open(const std::string & path, std::string & error)
+{
+    close();
+    if (!map_file(path, 0, "opening book", data, size, error))  return false;
+    if (size % BOOK_ENTRY_SIZE)
+    {
+        close();
+        error = "the book's size isn't a whole number of entries";
+        return false;
+    }
+    entries = size / BOOK_ENTRY_SIZE;
+    opened = true;
+    return true;
+}
+
+void OpeningBook::close()
+{
+    if (data)   ::munmap((void *)data, size);
+    data = nullptr;
+    size = entries = 0;
+    opened = false;
+}
+
+uint64_t OpeningBook::key_at(size_t index) const
+{
+    uint64_t key = 0;
+    for (int b = 0 ; b < 8 ; b++)   key = key << 8 | data[BOOK_ENTRY_SIZE * index + b];
+    return key;
+}
+
+size_t OpeningBook::first(uint64_t key) const
+{
+    size_t low = 0, high = entries;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (key_at(middle) < key)   low = middle + 1;
+        else                        high = middle;
+    }
+    return low;
+}
+
+Move OpeningBook::move_at(const Board & board, const LegalMoves & legal, size_t index, int & weight) const
+{
+    const unsigned char * p = data + BOOK_ENTRY_SIZE * index;
+    int move = p[8] << 8 | p[9];
+    weight = p[10] << 8 | p[11];
+    int origin = (move >> 6) & 63;
+    int destination = move & 63;
+    int promotion = (move >> 12) & 7;
+    Move m(origin, destination);
+    if (promotion >= 1 && promotion <= 4)   m = Move(origin, destination, PROMOTION, KNIGHT + promotion - 1);
+    else if (board.type_at(origin) == PAWN && destination == board.en_passant_square)   m = Move(origin, destination, EN_PASSANT);
+    // A book written for the full rules can hold moves this program doesn't play, like castling, so they are skipped.
+    return (promotion <= 4 && validate_move(board, legal, m) == MOVE_OK) ? m : Move();
+}
+
+int OpeningBook::probe(const Board & board, Move * moves, int * weights, int max) const
+{
+    uint64_t key = book_key(board);
+    size_t start = first(key);
+    if (start == entries || key_at(start) != key)   return 0;
+
+    LegalMoves legal;
+    legal.compute(board);
+    int found = 0;
+    for (size_t i = start ; i < entries && found < max && key_at(i) == key ; i++)
+    {
+        moves[found] = move_at(board, legal, i, weights[found]);
+        if (moves[found] != Move()) found++;
+    }
+    return found;
+}
+
+Move OpeningBook::pick(const Board & board, uint64_t random) const
+{
+    uint64_t key = book_key(board);
+    size_t start = first(key);
+    if (start == entries || key_at(start) != key)   return Move();
+
+    // The legal moves are generated once, and every entry of the position is checked against them on both passes.
+    LegalMoves legal;
+    legal.compute(board);
+    uint64_t total = 0;
+    int weight;
+    for (size_t i = start ; i < entries && key_at(i) == key ; i++)
+    {
+        if (move_at(board, legal, i, weight) != Move())  total += weight;
+    }
+    if (total == 0) return Move();
+
+    uint64_t roll = random % total;
+    for (size_t i = start ; i < entries && key_at(i) == key ; i++)
+    {
+        Move m = move_at(board, legal, i, weight);
+        if (m == Move())    continue;
+        if (roll < (uint64_t)weight)    return m;
+        roll -= weight;
+    }
+    return Move();
+}
+
+Tablebases tablebases;
+
+// A material key packs the count of each piece other than the kings into three bits: white's pawns to queens, then black's.
+static int material_shift(int color, int type)                      {return 3 * (5 * color + type);}
+static int material_count(uint32_t material, int color, int type)   {return (material >> material_shift(color, type)) & 7;}
+
+// flip_material() swaps the colors in a material key.
+static uint32_t flip_material(uint32_t material)    {return material >> 15 | (material & 0x7FFF) << 15;}
+
+// material_name() writes a material key as its pieces, white's first and each side's strongest first (i.e. "KRPvKR").
+static std::string material_name(uint32_t material)
+{
+    std::string name;
+    for (int color = WHITE ; color <= BLACK ; color++)
+    {
+        name += color == WHITE ? "K" : "vK";
+        for (int type = QUEEN ; type >= PAWN ; type--)  name.append(material_count(material, color, type), "PNBRQ"[type]);
+    }
+    return name;
+}
+
+// parse_material() is the reverse of material_name(). It returns false if the text isn't a set of pieces a table can hold.
+static bool parse_material(const std::string & text, uint32_t & material)
+{
+    size_t split = text.find('v');
+    if (split == std::string::npos) return false;
+    const std::string sides [2] = {text.substr(0, split), text.substr(split + 1)};
+    material = 0;
+    int pieces = 0;
+    for (int color = WHITE ; color <= BLACK ; color++)
+    {
+        if (sides[color].empty() || sides[color][0] != 'K') return false;
+        for (size_t i = 1 ; i < sides[color].size() ; i++)
+        {
+            size_t type = std::string("PNBRQ").find(sides[color][i]);
+            if (type == std::string::npos || ++pieces > TABLEBASE_MAX_PIECES - 2)   return false;
+            material += 1u << material_shift(color, type);
+        }
+    }
+    return true;
+}
+
+// canonical_material() returns the key a table is kept under. The colors are swapped if that makes white the stronger side.
+static uint32_t canonical_material(uint32_t material)
+{
+    const int values [5] = {1, 3, 3, 5, 9};
+    int strength [2] = {0, 0};
+    for (int color = WHITE ; color <= BLACK ; color++)
+    {
+        for (int type = PAWN ; type <= QUEEN ; type++)  strength[color] += values[type] * material_count(material, color, type);
+    }
+    uint32_t flipped = flip_material(material);
+    if (strength[BLACK] > strength[WHITE] || (strength[BLACK] == strength[WHITE] && flipped > material))   return flipped;
+    return material;
+}
+
+// material_of() returns the material key of the pieces on board. It only means anything when few enough pieces are left for a table.
+static uint32_t material_of(const Board & board)
+{
+    uint32_t material = 0;
+    for (int color = WHITE ; color <= BLACK ; color++)
+    {
+        for (int type = PAWN ; type <= QUEEN ; type++)  material += popcount(board.pieces[color][type]) << material_shift(color, type);
+    }
+    return material;
+}
+
+// TablebaseSymmetry holds the placements of the two kings a table indexes, and the reflections of the board that bring them there.
+// Without pawns the white king stays in the a1-d1-d4 triangle, with the black king on or below the a1-h8 diagonal while the white
+// king is on it. Pawns only move one way, so tables with them only mirror files, keeping the white king on files a to d.
+struct TablebaseSymmetry
+{
+    // pair_index[pawns][white king][black king] numbers each placement of the kings a table indexes, and is -1 for the others.
+    int pair_index [2][64][64];
+    std::vector <std::pair <int, int>> pairs [2];
+    // transform[t][square] is where square goes under reflection t: bit 2 reflects in the a1-h8 diagonal, then bit 0 mirrors the
+    // files and bit 1 the ranks.
+    int transform [8][64];
+
+    TablebaseSymmetry()
+    {
+        for (int t = 0 ; t < 8 ; t++)
+        {
+            for (int square = 0 ; square < 64 ; square++)
+            {
+                int file = square % 8, rank = square / 8;
+                if (t & 4)  std::swap(file, rank);
+                if (t & 1)  file = 7 - file;
+                if (t & 2)  rank = 7 - rank;
+                transform[t][square] = 8 * rank + file;
+            }
+        }
+        for (int pawns = 0 ; pawns < 2 ; pawns++)
+        {
+            for (int white = 0 ; white < 64 ; white++)
+            {
+                for (int black = 0 ; black < 64 ; black++)
+                {
+                    int file = white % 8, rank = white / 8;
+                    bool apart = white != black && !(king_attacks[white] & square_bit(black));
+                    bool indexed = pawns ? file < 4 : file < 4 && rank <= file && (rank != file || black / 8 <= black % 8);
+                    pair_index[pawns][white][black] = apart && indexed ? (int)pairs[pawns].size() : -1;
+                    if (apart && indexed)   pairs[pawns].push_back({white, black});
+                }
+            }
+        }
+    }
+};
+
+// symmetry() returns the one TablebaseSymmetry, built the first time it is needed, once the attack tables are ready.
+static const TablebaseSymmetry & symmetry()
+{
+    static const TablebaseSymmetry tables;
+    return tables;
+}
+
+// index() hands this back for a position with the kings next to each other, which no table holds.
+static const uint64_t NO_POSITION = ~0ULL;
+
+// The largest distance to mate a table can store, in plies. Codes then still fit in a byte.
+static const int TABLEBASE_MAX_DTM = 252;
+
+// A Tablebase is one table. Its pieces are kept in slots: the white king, the black king, then white's other pieces and black's,
+// each side's strongest first. Positions are numbered by the side to move, then the pair of kings, then the square in each other
+// slot, and each has a code of bits bits: 0 for a draw, 1 for a position that can't occur, and 2 + n for a mate in n plies, won by
+// the side to move when n is odd and lost when it is even.
+struct Tablebase
+{
+    std::string name;
+    uint32_t material;
+    int count = 2;
+    int colors [TABLEBASE_MAX_PIECES] = {WHITE, BLACK};
+    int types [TABLEBASE_MAX_PIECES] = {KING, KING};
+    bool pawns;
+    // The positions numbered for each side to move.
+    uint64_t size;
+    int bits = 0;
+    int longest = 0;
+    // The packed codes, from the lowest bit of each word up. A table just made owns them, and a loaded one maps them from its file.
+    std::vector <uint64_t> owned;
+    const uint64_t * codes = nullptr;
+    const unsigned char * data = nullptr;
+    size_t data_size = 0;
+
+    explicit Tablebase(uint32_t key) : name(material_name(key)), material(key)
+    {
+        for (int color = WHITE ; color <= BLACK ; color++)
+        {
+            for (int type = QUEEN ; type >= PAWN ; type--)
+            {
+                for (int n = 0 ; n < material_count(key, color, type) ; n++)
+                {
+                    colors[count] = color;
+                    types[count++] = type;
+                }
+            }
+        }
+        pawns = material_count(key, WHITE, PAWN) || material_count(key, BLACK, PAWN);
+        size = symmetry().pairs[pawns].size();
+        for (int i = 2 ; i < count ; i++)   size *= types[i] == PAWN ? 48 : 64;
+    }
+    Tablebase(const Tablebase &) = delete;
+    Tablebase & operator=(const Tablebase &) = delete;
+    ~Tablebase() {if (data) ::munmap((void *)data, data_size);}
+
+    // words() is the length of the packed codes. One spare word at the end lets code() always read two.
+    uint64_t words() const {return (2 * size * bits + 63) / 64 + 1;}
+
+    int code(uint64_t position) const
+    {
+        uint64_t bit = position * bits;
+        uint64_t word = codes[bit / 64] >> (bit % 64);
+        if (bit % 64 + bits > 64)   word |= codes[bit / 64 + 1] << (64 - bit % 64);
+        return word & ((1ULL << bits) - 1);
+    }
+
+    // index() numbers the position with the pieces on squares, in slot order, and color to move. Every reflection that puts the
+    // kings on an indexed pair is tried and the lowest number kept, so a position and its reflections share a number. Identical
+    // pieces could stand either way round, so they are always numbered in order of square.
+    uint64_t index(const int * squares, int color) const
+    {
+        const TablebaseSymmetry & s = symmetry();
+        uint64_t best = NO_POSITION;
+        for (int t = 0 ; t < (pawns ? 2 : 8) ; t++)
+        {
+            int pair = s.pair_index[pawns][s.transform[t][squares[0]]][s.transform[t][squares[1]]];
+            if (pair < 0)   continue;
+            int moved [TABLEBASE_MAX_PIECES];
+            for (int i = 2 ; i < count ; i++)   moved[i] = s.transform[t][squares[i]];
+            for (int i = 3 ; i < count ; i++)
+            {
+                for (int j = i ; j > 2 && colors[j - 1] == colors[j] && types[j - 1] == types[j] && moved[j - 1] > moved[j] ; j--)    std::swap(moved[j - 1], moved[j]);
+            }
+            uint64_t position = pair;
+            for (int i = 2 ; i < count ; i++)   position = types[i] == PAWN ? position * 48 + moved[i] - 8 : position * 64 + moved[i];
+            best = std::min(best, position);
+        }
+        return best == NO_POSITION ? best : color * size + best;
+    }
+
+    // decode() is the reverse of index(). It fills squares from a position number and returns the color to move.
+    int decode(uint64_t position, int * squares) const
+    {
+        int color = position >= size;
+        position -= color * size;
+        for (int i = count - 1 ; i >= 2 ; i--)
+        {
+            int range = types[i] == PAWN ? 48 : 64;
+            squares[i] = position % range + (types[i] == PAWN ? 8 : 0);
+            position /= range;
+        }
+        squares[0] = symmetry().pairs[pawns][position].first;
+        squares[1] = symmetry().pairs[pawns][position].second;
+        return color;
+    }
+
+    // set_up() puts the position on board. It returns false if two pieces share a square or the side that just moved is in check.
+    bool set_up(const int * squares, int color, Board & board) const
+    {
+        board.clear();
+        for (int i = 0 ; i < count ; i++)
+        {
+            if (!board.is_empty(squares[i]))    return false;
+            board.put_piece(colors[i], types[i], squares[i]);
+        }
+        board.side_to_move = color;
+        board.update_attacks();
+        return !check_for_check(&board, color == BLACK);
+    }
+
+    // squares_of() reads the square of each slot from board. With flip, the board is taken with the colors swapped and the ranks mirrored.
+    void squares_of(const Board & board, bool flip, int * squares) const
+    {
+        Bitboard left [2][6];
+        std::memcpy(left, board.pieces, sizeof(left));
+        for (int i = 0 ; i < count ; i++)
+        {
+            int square = pop_lowest_square(left[colors[i] ^ flip][types[i]]);
+            squares[i] = flip ? square ^ 56 : square;
+        }
+    }
+};
+
+// write_tablebase() saves a table to path: a 64-byte header ("TCTB", a byte order mark, the material key, the code size in bits,
+// the number of positions and the longest mate), then the packed codes.
+static bool write_tablebase(const Tablebase & table, const std::string & path, std::string & error)
+{
+    uint64_t header [8] = {};
+    std::memcpy(header, "TCTB", 4);
+    uint32_t byte_order = 0x01020304;
+    std::memcpy((unsigned char *)header + 4, &byte_order, 4);
+    header[1] = table.material;
+    header[2] = table.bits;
+    header[3] = 2 * table.size;
+    header[4] = table.longest;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write((const char *)header, sizeof(header));
+    file.write((const char *)table.codes, 8 * table.words());
+    file.close();
+    if (file.fail())
+    {
+        error = "the tablebase " + path + " can't be written";
+        return false;
+    }
+    return true;
+}
+
+// read_tablebase() maps the table saved at path.
+static bool read_tablebase(const std::string & path, std::unique_ptr <Tablebase> & table, std::string & error)
+{
+    const unsigned char * data;
+    size_t size;
+    if (!map_file(path, 64, "tablebase", data, size, error))    return false;
+
+    uint64_t header [8];
+    uint32_t byte_order;
+    std::memcpy(header, data, sizeof(header));
+    std::memcpy(&byte_order, data + 4, 4);
+    uint32_t material = header[1];
+    if (std::memcmp(data, "TCTB", 4) != 0 || byte_order != 0x01020304 || header[1] >> 30 || !parse_material(material_name(material), material))
+    {
+        ::munmap((void *)data, size);
+        error = "the file isn't a tablebase written on this kind of machine";
+        return false;
+    }
+    table.reset(new Tablebase(material));
+    table->data = data;
+    table->data_size = size;
+    table->bits = header[2];
+    table->longest = header[4];
+    if (header[2] < 1 || header[2] > 8 || header[3] != 2 * table->size || size != 64 + 8 * table->words())
+    {
+        error = "the tablebase is damaged";
+        return false;
+    }
+    table->codes = (const uint64_t *)(data + 64);
+    return true;
+}
+
+Tablebases::Tablebases() {}
+Tablebases::~Tablebases() {}
+
+bool Tablebases::load(const std::string & directory, std::string & error)
+{
+    std::vector <std::string> paths;
+    std::error_code code;
+    for (std::filesystem::directory_iterator it(directory, code), end ; !code && it != end ; it.increment(code))
+    {
+        if (it->path().extension() == ".tctb")  paths.push_back(it->path().string());
+    }
+    if (code)
+    {
+        error = "the directory " + directory + " can't be read";
+        return false;
+    }
+    std::sort(paths.begin(), paths.end());
+    for (const std::string & path : paths)
+    {
+        std::unique_ptr <Tablebase> table;
+        if (!read_tablebase(path, table, error))
+        {
+            error = path + ": " + error;
+            return false;
+        }
+        if (!find(table->material)) add(std::move(table));
+    }
+    return true;
+}
+
+bool Tablebases::generate(const std::string & material, const std::string & directory, int threads, std::vector <TablebaseReport> & reports, std::string & error)
+{
+    uint32_t key;
+    if (!parse_material(material, key))
+    {
+        error = "\"" + material + "\" isn't a set of pieces like \"KRvKP\", with at most " + std::to_string(TABLEBASE_MAX_PIECES) + " pieces";
+        return false;
+    }
+    std::error_code code;
+    std::filesystem::create_directories(directory, code);
+    return generate(canonical_material(key), directory, std::max(threads, 1), reports, error);
+}
+
+bool Tablebases::generate(uint32_t material, const std::string & directory, int threads, std::vector <TablebaseReport> & reports, std::string & error)
+{
+    // Two bare kings are a draw, with no table needed.
+    if (material == 0 || find(material))    return true;
+    std::string path = directory + "/" + material_name(material) + ".tctb";
+    if (std::filesystem::exists(path))
+    {
+        std::unique_ptr <Tablebase> table;
+        if (!read_tablebase(path, table, error))
+        {
+            error = path + ": " + error;
+            return false;
+        }
+        add(std::move(table));
+        return true;
+    }
+
+    // Every capture takes one piece away, and every promotion turns a pawn into another piece, perhaps while capturing.
+    for (int color = WHITE ; color <= BLACK ; color++)
+    {
+        for (int type = PAWN ; type <= QUEEN ; type++)
+        {
+            if (!material_count(material, color, type)) continue;
+            uint32_t fewer = material - (1u << material_shift(color, type));
+            if (!generate(canonical_material(fewer), directory, threads, reports, error))   return false;
+            if (type != PAWN)   continue;
+            for (int promotion = KNIGHT ; promotion <= QUEEN ; promotion++)
+            {
+                uint32_t promoted = fewer + (1u << material_shift(color, promotion));
+                if (!generate(canonical_material(promoted), directory, threads, reports, error))    return false;
+                for (int captured = KNIGHT ; captured <= QUEEN ; captured++)
+                {
+                    if (!material_count(promoted, !color, captured))    continue;
+                    if (!generate(canonical_material(promoted - (1u << material_shift(!color, captured))), directory, threads, reports, error))  return false;
+                }
+            }
+        }
+    }
+
+    std::unique_ptr <Tablebase> table(new Tablebase(material));
+    TablebaseReport report;
+    if (!build(*table, threads, report, error) || !write_tablebase(*table, path, error))    return false;
+    reports.push_back(report);
+    add(std::move(table));
+    return true;
+}
+
+// build() works out every position of a table whose captures and promotions lead to tables already held.
+// Each position is first scored from its moves out of the table, and its moves within the table are counted. Then positions are
+// settled one distance to mate at a time, starting from the checkmates. Taking back a move from a position lost in n plies wins
+// in n + 1, and taking back a move from a position won in n plies uses up one of that position's replies; once all are used up it
+// is lost, in one ply more than its longest reply. Whatever is left at the end is a draw.
+// Both passes split positions among the threads, which only share the reply counts, through atomics.
+bool Tablebases::build(Tablebase & table, int threads, TablebaseReport & report, std::string & error) const
+{
+    typedef std::vector <std::vector <uint32_t>> Layers;
+    auto start = std::chrono::steady_clock::now();
+    const uint64_t total = 2 * table.size;
+    // A state is one of these, or RESOLVED + n for a mate in n plies.
+    const uint8_t UNKNOWN = 0, IMPOSSIBLE = 1, DRAWN = 2, RESOLVED = 3;
+    std::unique_ptr <uint8_t []> state(new uint8_t [total]);
+    std::unique_ptr <std::atomic <uint8_t> []> replies(new std::atomic <uint8_t> [total]);
+    // The soonest a position can be lost given its replies out of the table, or 255 if one of those doesn't win.
+    std::unique_ptr <uint8_t []> loss_floor(new uint8_t [total]);
+    // layers[n] holds the positions that may be mated in n plies, to be settled in that order.
+    Layers layers;
+    std::mutex layers_lock;
+    std::atomic <bool> too_long {false};
+    size_t peak_layer_bytes = 0;
+
+    auto push = [&](Layers & found, int distance, uint64_t position)
+    {
+        if (distance > TABLEBASE_MAX_DTM)
+        {
+            too_long = true;
+            return;
+        }
+        if ((int)found.size() <= distance)  found.resize(distance + 1);
+        found[distance].push_back(position);
+    };
+
+    // run_parallel() has the threads call work() on chunks of positions 0 to count - 1, and then adds what they found to layers.
+    auto run_parallel = [&](uint64_t count, const std::function <void(uint64_t, uint64_t, Layers &, UndoStack &)> & work)
+    {
+        std::atomic <uint64_t> next {0};
+        auto worker = [&]()
+        {
+            const uint64_t chunk = 4096;
+            Layers found;
+            std::unique_ptr <UndoStack> history(new UndoStack());
+            for (uint64_t begin = next.fetch_add(chunk) ; begin < count ; begin = next.fetch_add(chunk))   work(begin, std::min(begin + chunk, count), found, *history);
+            std::lock_guard <std::mutex> guard(layers_lock);
+            if (found.size() > layers.size())   layers.resize(found.size());
+            for (size_t n = 0 ; n < found.size() ; n++) layers[n].insert(layers[n].end(), found[n].begin(), found[n].end());
+        };
+        std::vector <std::thread> pool;
+        for (int i = 1 ; i < threads ; i++) pool.emplace_back(worker);
+        worker();
+        for (std::thread & t : pool)    t.join();
+    };
+
+    run_parallel(total, [&](uint64_t begin, uint64_t end, Layers & found, UndoStack & history)
+    {
+        Board board;
+        int squares [TABLEBASE_MAX_PIECES];
+        for (uint64_t position = begin ; position < end ; position++)
+        {
+            replies[position].store(0, std::memory_order_relaxed);
+            loss_floor[position] = 255;
+            int color = table.decode(position, squares);
+            if (!table.set_up(squares, color, board) || table.index(squares, color) != position)
+            {
+                state[position] = IMPOSSIBLE;
+                continue;
+            }
+            state[position] = UNKNOWN;
+
+            MoveList list;
+            generate_legal_moves(board, list);
+            if (list.size == 0)
+            {
+                if (check_for_check(&board, color == WHITE))    push(found, 0, position);
+                else                                            state[position] = DRAWN;
+                continue;
+            }
+
+            uint64_t inside [MAX_MOVES];
+            int count = 0, win = 0, longest_win = -1;
+            bool can_lose = true;
+            for (Move m : list)
+            {
+                bool leaves = !board.is_empty(m.destination()) || m.flag() == PROMOTION;
+                board.make_move(m, history);
+                if (leaves)
+                {
+                    int code = code_of(board);
+                    int distance = code - 2;
+                    if (code < 2 || distance % 2 == 0)  can_lose = false;
+                    if (code >= 2 && distance % 2 == 0) win = win ? std::min(win, distance + 1) : distance + 1;
+                    if (code >= 2 && distance % 2 == 1) longest_win = std::max(longest_win, distance);
+                }
+                else
+                {
+                    int after [TABLEBASE_MAX_PIECES];
+                    table.squares_of(board, false, after);
+                    inside[count++] = table.index(after, board.side_to_move);
+                }
+                board.unmake_move(history);
+            }
+            std::sort(inside, inside + count);
+            count = std::unique(inside, inside + count) - inside;
+            replies[position].store(count, std::memory_order_relaxed);
+
+            if (win)        push(found, win, position);
+            if (can_lose)
+            {
+                loss_floor[position] = longest_win + 1;
+                if (count == 0) push(found, longest_win + 1, position);
+            }
+            if (!win && !can_lose && count == 0)    state[position] = DRAWN;
+        }
+    });
+
+    for (size_t distance = 0 ; distance < layers.size() && !too_long ; distance++)
+    {
+        size_t layer_bytes = 0;
+        for (const std::vector <uint32_t> & layer : layers)    layer_bytes += 4 * layer.capacity();
+        peak_layer_bytes = std::max(peak_layer_bytes, layer_bytes);
+
+        std::vector <uint32_t> candidates = std::move(layers[distance]);
+        std::vector <uint32_t> frontier;
+        for (uint32_t position : candidates)
+        {
+            if (state[position] != UNKNOWN) continue;
+            state[position] = RESOLVED + distance;
+            frontier.push_back(position);
+        }
+        candidates = std::vector <uint32_t>();
+
+        bool won = distance % 2 == 1;
+        run_parallel(frontier.size(), [&](uint64_t begin, uint64_t end, Layers & found, UndoStack &)
+        {
+            int squares [TABLEBASE_MAX_PIECES], before [TABLEBASE_MAX_PIECES];
+            // No piece can take back more than 27 moves, so this holds every move into a position.
+            uint64_t parents [TABLEBASE_MAX_PIECES * 27];
+            for (uint64_t k = begin ; k < end ; k++)
+            {
+                int mover = !table.decode(frontier[k], squares);
+                Bitboard occupancy = 0;
+                for (int i = 0 ; i < table.count ; i++) occupancy |= square_bit(squares[i]);
+
+                int count = 0;
+                for (int i = 0 ; i < table.count ; i++)
+                {
+                    if (table.colors[i] != mover)   continue;
+                    int square = squares[i];
+                    Bitboard origins;
+                    if (table.types[i] == PAWN)
+                    {
+                        // A pawn steps back one square, or two to its starting rank, and never onto its first rank.
+                        int back = mover == WHITE ? -8 : 8;
+                        int rank = mover == WHITE ? square / 8 : 7 - square / 8;
+                        origins = 0;
+                        if (rank >= 2 && !(occupancy & square_bit(square + back)))
+                        {
+                            origins |= square_bit(square + back);
+                            if (rank == 3 && !(occupancy & square_bit(square + 2 * back)))  origins |= square_bit(square + 2 * back);
+                        }
+                    }
+                    else    origins = piece_attacks(table.types[i], mover, square, occupancy) & ~occupancy;
+                    while (origins)
+                    {
+                        std::memcpy(before, squares, sizeof(before));
+                        before[i] = pop_lowest_square(origins);
+                        uint64_t parent = table.index(before, mover);
+                        if (parent != NO_POSITION)  parents[count++] = parent;
+                    }
+                }
+                std::sort(parents, parents + count);
+                count = std::unique(parents, parents + count) - parents;
+
+                for (int p = 0 ; p < count ; p++)
+                {
+                    uint64_t parent = parents[p];
+                    if (state[parent] != UNKNOWN)   continue;
+                    if (!won)   push(found, distance + 1, parent);
+                    else if (replies[parent].fetch_sub(1, std::memory_order_relaxed) == 1 && loss_floor[parent] != 255)
+                        push(found, std::max<int>(distance + 1, loss_floor[parent]), parent);
+                }
+            }
+        });
+    }
+    if (too_long)
+    {
+        error = "the table " + table.name + " has a mate longer than " + std::to_string(TABLEBASE_MAX_DTM) + " plies";
+        return false;
+    }
+
+    report = TablebaseReport();
+    report.name = table.name;
+    report.positions = total;
+    table.longest = 0;
+    for (uint64_t position = 0 ; position < total ; position++)
+    {
+        if (state[position] == IMPOSSIBLE)  continue;
+        if (state[position] < RESOLVED)     report.draws++;
+        else if ((state[position] - RESOLVED) % 2) report.wins++;
+        else                                report.losses++;
+        if (state[position] >= RESOLVED)    table.longest = std::max(table.longest, state[position] - RESOLVED);
+    }
+
+    table.bits = 1;
+    while ((1 << table.bits) <= 2 + table.longest)  table.bits++;
+    table.owned.assign(table.words(), 0);
+    for (uint64_t position = 0 ; position < total ; position++)
+    {
+        uint64_t code = state[position] == IMPOSSIBLE ? 1 : state[position] >= RESOLVED ? state[position] - RESOLVED + 2 : 0;
+        uint64_t bit = position * table.bits;
+        table.owned[bit / 64] |= code << (bit % 64);
+        if (bit % 64 + table.bits > 64) table.owned[bit / 64 + 1] |= code >> (64 - bit % 64);
+    }
+    table.codes = table.owned.data();
+
+    report.longest = table.longest;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report.table_bytes = 8 * table.owned.size();
+    report.working_bytes = 3 * total + peak_layer_bytes + report.table_bytes;
+    return true;
+}
+
+bool Tablebases::probe_table(const Board & board, int & wdl, int & dtm) const
+{
+    int code = code_of(board);
+    if (code < 0 || code == 1)  return false;
+    dtm = code ? code - 2 : 0;
+    wdl = code == 0 ? 0 : dtm % 2 ? 1 : -1;
+    return true;
+}
+
+int Tablebases::code_of(const Board & board) const
+{
+    uint32_t material = material_of(board);
+    if (material == 0)  return 0;
+    // A table holds its pieces one way round, so with the colors the other way the board is looked at from black's side.
+    bool flip = false;
+    const Tablebase * table = find(material);
+    if (!table)
+    {
+        flip = true;
+        table = find(flip_material(material));
+    }
+    if (!table) return -1;
+    int squares [TABLEBASE_MAX_PIECES];
+    table->squares_of(board, flip, squares);
+    return table->code(table->index(squares, board.side_to_move ^ flip));
+}
+
+const Tablebase * Tablebases::find(uint32_t material) const
+{
+    auto it = std::lower_bound(index.begin(), index.end(), std::make_pair(material, (const Tablebase *)nullptr));
+    return it != index.end() && it->first == material ? it->second : nullptr;
+}
+
+void Tablebases::add(std::unique_ptr <Tablebase> table)
+{
+    largest = std::max(largest, table->count);
+    auto entry = std::make_pair(table->material, (const Tablebase *)table.get());
+    index.insert(std::lower_bound(index.begin(), index.end(), entry), entry);
+    tables.push_back(std::move(table));
+}
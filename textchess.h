@@ -0,0 +1,1169 @@
+/*
+    TEXTCHESS LIBRARY
+
+    The chess core behind the terminal game, with no terminal input or output, so it can be used from batch jobs,
+    threads or a server. It covers the board and its moves, move generation, move parsing and validation, and the search.
+    Build it as libtextchess from textchess.cpp, and see chess.cpp for a program that uses it.
+*/
+
+#ifndef TEXTCHESS_H
+#define TEXTCHESS_H
+
+#include <string>
+#include <iosfwd>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// A Bitboard is a 64-bit set of squares. Bit i corresponds to element i of the board (a1 = 0, b1 = 1, ..., h8 = 63).
+typedef uint64_t Bitboard;
+
+// Piece types, used to index the bitboards and the mailbox in class Board.
+enum PieceType {PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING, NO_PIECE};
+
+// Colors, used to index the bitboards in class Board.
+enum Color {WHITE, BLACK};
+
+// A Piece is a piece type and color packed into one small integer: the type in the low three bits and the color above them.
+typedef uint8_t Piece;
+
+// EMPTY is the Piece stored in the mailbox for a square with nothing on it.
+const Piece EMPTY = NO_PIECE;
+
+inline Piece make_piece(int color, int type)    {return type | (color << 3);}
+inline int piece_type(Piece p)                  {return p & 7;}
+inline int piece_color(Piece p)                 {return p >> 3;}
+
+// square_bit() returns a bitboard containing only the given square.
+inline Bitboard square_bit(int square) {return 1ULL << square;}
+
+// lowest_square() returns the lowest numbered square in a non-empty bitboard.
+inline int lowest_square(Bitboard b) {return __builtin_ctzll(b);}
+
+// pop_lowest_square() removes the lowest numbered square from a non-empty bitboard and returns it.
+inline int pop_lowest_square(Bitboard & b)
+{
+    int square = __builtin_ctzll(b);
+    b &= b - 1;
+    return square;
+}
+
+// popcount() returns the number of squares in a bitboard.
+inline int popcount(Bitboard b) {return __builtin_popcountll(b);}
+
+// Squares attacked by a knight, king, or pawn of each color standing on each square. Filled in by init_attack_tables().
+extern Bitboard knight_attacks [64];
+extern Bitboard king_attacks [64];
+extern Bitboard pawn_attacks [2][64];
+
+// between_squares[a][b] holds the squares strictly between a and b when they share a rank, file, or diagonal, and is empty otherwise.
+// line_through[a][b] holds the whole line through a and b, edge to edge, under the same condition.
+extern Bitboard between_squares [64][64];
+extern Bitboard line_through [64][64];
+
+// A Magic holds the lookup data for the sliding attacks of one rook or bishop square.
+// The relevant blockers of occupied are hashed into an index into that square's slice of the attack table.
+struct Magic
+{
+    Bitboard mask;
+    Bitboard magic;
+    Bitboard * attacks;
+    int shift;
+
+    unsigned index(Bitboard occupied) const
+    {
+#if defined(__BMI2__)
+        return (unsigned)_pext_u64(occupied, mask);
+#else
+        return (unsigned)(((occupied & mask) * magic) >> shift);
+#endif
+    }
+};
+
+extern Magic rook_magics [64];
+extern Magic bishop_magics [64];
+
+// rook_attacks() and bishop_attacks() return the squares a slider on the given square attacks, stopping at the first blocker in each direction.
+inline Bitboard rook_attacks(int square, Bitboard occupied)     {return rook_magics[square].attacks[rook_magics[square].index(occupied)];}
+inline Bitboard bishop_attacks(int square, Bitboard occupied)   {return bishop_magics[square].attacks[bishop_magics[square].index(occupied)];}
+inline Bitboard queen_attacks(int square, Bitboard occupied)    {return rook_attacks(square, occupied) | bishop_attacks(square, occupied);}
+
+// piece_attacks() returns the squares attacked by a piece of the given type and color on the given square.
+inline Bitboard piece_attacks(int type, int color, int square, Bitboard occupied)
+{
+    switch (type)
+    {
+        case PAWN:      return pawn_attacks[color][square];
+        case KNIGHT:    return knight_attacks[square];
+        case BISHOP:    return bishop_attacks(square, occupied);
+        case ROOK:      return rook_attacks(square, occupied);
+        case QUEEN:     return queen_attacks(square, occupied);
+        case KING:      return king_attacks[square];
+    }
+    return 0;
+}
+
+// Random keys for Zobrist hashing. A position's key is the XOR of the key for each piece on its square,
+// plus zobrist_side when black is to move and the key for the file of the en passant square when there is one.
+extern uint64_t zobrist_piece_square [16][64];
+extern uint64_t zobrist_side;
+extern uint64_t zobrist_en_passant [8];
+
+// The value of each piece type in centipawns. Kings are never traded, so they count for nothing.
+const int piece_values [7] = {100, 320, 330, 500, 900, 0, 0};
+
+// Piece-square scores: psq_mg[p][square] and psq_eg[p][square] are what piece p standing on square adds to the middlegame and
+// endgame scores, from white's point of view and with the piece's value included. Black's are white's mirrored and negated.
+// Each row is aligned so that it can be loaded straight into vector registers.
+alignas(32) extern int16_t psq_mg [16][64];
+alignas(32) extern int16_t psq_eg [16][64];
+
+// The most material other than pawns the board can start with, in centipawns. Evaluation is purely the endgame score at 0.
+const int OPENING_MATERIAL = 2 * (2 * 320 + 2 * 330 + 2 * 500 + 900);
+
+// Kinds of move that need special handling when they are played.
+enum MoveFlag {NORMAL, PROMOTION, EN_PASSANT};
+
+// A Move packs the origin square (bits 0-5), destination square (bits 6-11), promotion piece (bits 12-13) and flag (bits 14-15) into 16 bits.
+struct Move
+{
+    uint16_t data;
+
+    Move() {data = 0;}
+    Move(int origin, int destination, int flag = NORMAL, int promotion = KNIGHT)
+    {
+        data = origin | (destination << 6) | ((promotion - KNIGHT) << 12) | (flag << 14);
+    }
+
+    int origin() const      {return data & 63;}
+    int destination() const {return (data >> 6) & 63;}
+    int promotion() const   {return KNIGHT + ((data >> 12) & 3);}
+    int flag() const        {return data >> 14;}
+
+    bool operator==(const Move & other) const {return data == other.data;}
+    bool operator!=(const Move & other) const {return data != other.data;}
+};
+
+// The most legal moves any chess position can have is 218, so a MoveList never needs to grow.
+const int MAX_MOVES = 256;
+
+// A MoveList is a fixed-capacity buffer of moves that lives on the stack.
+struct MoveList
+{
+    Move moves [MAX_MOVES];
+    int size = 0;
+
+    void add(Move m)    {moves[size++] = m;}
+    Move * begin()      {return moves;}
+    Move * end()        {return moves + size;}
+};
+
+// An Undo records what make_move() can't work out again when the move is taken back.
+// The promotion piece and en passant flag travel inside the move itself.
+struct Undo
+{
+    // The board's key before the move.
+    uint64_t key;
+    Move move;
+    // The piece captured on the destination square, or EMPTY.
+    Piece captured;
+    // The board's en_passant_square before the move.
+    int8_t en_passant_square;
+    // The board's halfmove_clock before the move.
+    uint16_t halfmove_clock;
+    // The board's attack maps and checkers before the move.
+    Bitboard attacked [2];
+    Bitboard checkers;
+};
+
+// No game can last longer than this many plies without breaking the 50 move rule.
+const int MAX_PLIES = 12000;
+
+// An UndoStack holds one Undo per move played, so moves can be taken back to any depth without copying the board.
+struct UndoStack
+{
+    Undo records [MAX_PLIES];
+    int size = 0;
+
+    Undo & push()               {return records[size++];}
+    const Undo & pop()          {return records[--size];}
+    const Undo & top() const    {return records[size - 1];}
+    bool empty() const          {return size == 0;}
+};
+
+// Class "Board" represents the board
+class Board
+{
+    public:
+        // One bitboard per color and piece type. A set bit means that piece stands on that square.
+        Bitboard pieces [2][6];
+        // The union of all of a color's piece bitboards.
+        Bitboard occupied [2];
+        // The piece standing on each square, or EMPTY. Numbering travels down the ranks and then the files.
+        Piece mailbox [64];
+        // The square a pawn skipped over with a two-square move on the previous turn, or -1.
+        int en_passant_square;
+        // The color whose turn it is.
+        int side_to_move;
+        // Moves since the last capture or pawn move. Positions before that can't repeat, and at 100 the 50 move rule applies.
+        int halfmove_clock;
+        // The number of the current move, starting at 1 and counting up after each black move.
+        int fullmove_number;
+        // The Zobrist key of the position, kept up to date as pieces are placed, moved and removed.
+        // Two positions with the same pieces, side to move and en passant square always share a key.
+        uint64_t key;
+        // The sum of the piece-square scores of every piece on the board, in the middlegame and the endgame, and the value of each
+        // color's pieces other than pawns. They are kept up to date alongside the key.
+        int mg_score;
+        int eg_score;
+        int material [2];
+        // The Zobrist key of the pawns alone, which picks out the pawn structure in a PawnTable.
+        uint64_t pawn_key;
+        // The square of each color's king.
+        int king_square [2];
+        // Every square each color attacks, kept up to date by make_move() and unmake_move(). Sliders see through the enemy king,
+        // so a king in check can't escape by stepping back along the line of the check.
+        Bitboard attacked [2];
+        // The enemy pieces giving check to the side to move.
+        Bitboard checkers;
+
+        Board()
+        {
+            clear();
+
+            // Populate board with pieces in standard initial positions.
+            const PieceType back_rank [8] = {ROOK, KNIGHT, BISHOP, QUEEN, KING, BISHOP, KNIGHT, ROOK};
+            for (int i = 0 ; i < 8 ; i++)
+            {
+                put_piece(WHITE, back_rank[i], i);
+                put_piece(WHITE, PAWN, i + 8);
+                put_piece(BLACK, PAWN, i + 48);
+                put_piece(BLACK, back_rank[i], i + 56);
+            }
+            update_attacks();
+        }
+
+        // Create empty board.
+        void clear()
+        {
+            for (int c = 0 ; c < 2 ; c++)
+            {
+                for (int t = 0 ; t < 6 ; t++)   pieces[c][t] = 0;
+                occupied[c] = 0;
+            }
+            for (int i = 0 ; i < 64 ; i++)  mailbox[i] = EMPTY;
+            en_passant_square = -1;
+            side_to_move = WHITE;
+            halfmove_clock = 0;
+            fullmove_number = 1;
+            key = 0;
+            mg_score = eg_score = 0;
+            material[WHITE] = material[BLACK] = 0;
+            pawn_key = 0;
+            king_square[WHITE] = king_square[BLACK] = 0;
+            attacked[WHITE] = attacked[BLACK] = 0;
+            checkers = 0;
+        }
+
+        bool from_fen(const std::string & fen, std::string * error = nullptr);
+        std::string to_fen() const;
+
+        // Place a piece of the given color and type on an empty square.
+        void put_piece(int color, int type, int square)
+        {
+            pieces[color][type] |= square_bit(square);
+            occupied[color] |= square_bit(square);
+            mailbox[square] = make_piece(color, type);
+            key ^= zobrist_piece_square[mailbox[square]][square];
+            mg_score += psq_mg[mailbox[square]][square];
+            eg_score += psq_eg[mailbox[square]][square];
+            if (type != PAWN)   material[color] += piece_values[type];
+            else                pawn_key ^= zobrist_piece_square[mailbox[square]][square];
+        }
+
+        // Move whatever piece stands on origin to the empty square destination.
+        void move_piece(int origin, int destination)
+        {
+            Piece p = mailbox[origin];
+            Bitboard change = square_bit(origin) | square_bit(destination);
+            pieces[piece_color(p)][piece_type(p)] ^= change;
+            occupied[piece_color(p)] ^= change;
+            mailbox[destination] = p;
+            mailbox[origin] = EMPTY;
+            key ^= zobrist_piece_square[p][origin] ^ zobrist_piece_square[p][destination];
+            mg_score += psq_mg[p][destination] - psq_mg[p][origin];
+            eg_score += psq_eg[p][destination] - psq_eg[p][origin];
+            if (piece_type(p) == PAWN)  pawn_key ^= zobrist_piece_square[p][origin] ^ zobrist_piece_square[p][destination];
+        }
+
+        // Remove whatever piece stands on an occupied square.
+        void remove_piece(int square)
+        {
+            Piece p = mailbox[square];
+            pieces[piece_color(p)][piece_type(p)] &= ~square_bit(square);
+            occupied[piece_color(p)] &= ~square_bit(square);
+            mailbox[square] = EMPTY;
+            key ^= zobrist_piece_square[p][square];
+            mg_score -= psq_mg[p][square];
+            eg_score -= psq_eg[p][square];
+            if (piece_type(p) != PAWN)  material[piece_color(p)] -= piece_values[piece_type(p)];
+            else                        pawn_key ^= zobrist_piece_square[p][square];
+        }
+
+        // compute_key() works out the Zobrist key from scratch. It is used to set up a position and to check the key kept by make_move().
+        uint64_t compute_key() const
+        {
+            uint64_t k = 0;
+            for (int square = 0 ; square < 64 ; square++)
+            {
+                if (!is_empty(square))  k ^= zobrist_piece_square[mailbox[square]][square];
+            }
+            if (side_to_move == BLACK)  k ^= zobrist_side;
+            if (en_passant_square >= 0) k ^= zobrist_en_passant[en_passant_square % 8];
+            return k;
+        }
+
+        // compute_scores() works out mg_score, eg_score and material from scratch, with vector instructions where the build has them.
+        // It is used to set up a position and to check the scores kept by make_move().
+        void compute_scores(int & mg, int & eg, int * values) const;
+
+        // Every occupied square, regardless of color.
+        Bitboard all_pieces() const {return occupied[WHITE] | occupied[BLACK];}
+
+        // attacks_by() works out from scratch every square the given color attacks, seeing through the enemy king.
+        Bitboard attacks_by(int color) const
+        {
+            const Bitboard not_a_file = ~0x0101010101010101ULL, not_h_file = ~0x8080808080808080ULL;
+            Bitboard occupancy = all_pieces() ^ pieces[!color][KING];
+            Bitboard pawns = pieces[color][PAWN];
+            Bitboard attacks = color == WHITE ? (pawns & not_a_file) << 7 | (pawns & not_h_file) << 9
+                                              : (pawns & not_a_file) >> 9 | (pawns & not_h_file) >> 7;
+            for (Bitboard b = pieces[color][KNIGHT] ; b ; )                         attacks |= knight_attacks[pop_lowest_square(b)];
+            for (Bitboard b = pieces[color][BISHOP] | pieces[color][QUEEN] ; b ; )  attacks |= bishop_attacks(pop_lowest_square(b), occupancy);
+            for (Bitboard b = pieces[color][ROOK] | pieces[color][QUEEN] ; b ; )    attacks |= rook_attacks(pop_lowest_square(b), occupancy);
+            return attacks | king_attacks[king_square[color]];
+        }
+
+        // update_attacks() sets the king squares, attack maps and checkers from the pieces. Positions set up with put_piece() call it
+        // once every piece, both kings included, is on the board. After that, make_move() and unmake_move() keep them up to date.
+        void update_attacks()
+        {
+            king_square[WHITE] = lowest_square(pieces[WHITE][KING]);
+            king_square[BLACK] = lowest_square(pieces[BLACK][KING]);
+            attacked[WHITE] = attacks_by(WHITE);
+            attacked[BLACK] = attacks_by(BLACK);
+            int us = side_to_move;
+            checkers = (attacked[!us] & pieces[us][KING]) ? attackers_to(king_square[us], all_pieces()) & occupied[!us] : 0;
+        }
+
+        // Every piece of either color that attacks the given square, given an occupancy for the sliders to stop at.
+        Bitboard attackers_to(int square, Bitboard occupancy) const
+        {
+            return (pawn_attacks[BLACK][square] & pieces[WHITE][PAWN])
+                 | (pawn_attacks[WHITE][square] & pieces[BLACK][PAWN])
+                 | (knight_attacks[square] & (pieces[WHITE][KNIGHT] | pieces[BLACK][KNIGHT]))
+                 | (king_attacks[square] & (pieces[WHITE][KING] | pieces[BLACK][KING]))
+                 | (bishop_attacks(square, occupancy) & (pieces[WHITE][BISHOP] | pieces[BLACK][BISHOP] | pieces[WHITE][QUEEN] | pieces[BLACK][QUEEN]))
+                 | (rook_attacks(square, occupancy) & (pieces[WHITE][ROOK] | pieces[BLACK][ROOK] | pieces[WHITE][QUEEN] | pieces[BLACK][QUEEN]));
+        }
+
+        // Returns true if any piece of the given color attacks the given square.
+        bool is_attacked(int square, int by_color) const {return attackers_to(square, all_pieces()) & occupied[by_color];}
+
+        bool is_empty(int square) const {return mailbox[square] == EMPTY;}
+
+        // The color of the piece on an occupied square.
+        int color_at(int square) const {return piece_color(mailbox[square]);}
+
+        // The type of the piece on a square, or NO_PIECE.
+        int type_at(int square) const {return piece_type(mailbox[square]);}
+
+        // can_move() decides if the piece on origin may move to the empty square destination, following that piece type's rules.
+        // Whether the move leaves the king in check is up to the caller.
+        bool can_move(int origin, int destination) const
+        {
+            Piece p = mailbox[origin];
+            int color = piece_color(p);
+            switch (piece_type(p))
+            {
+                case PAWN:
+                {
+                    int direction = (color == WHITE) ? 8 : -8;
+                    // A pawn still on its starting rank may advance two squares if both are empty.
+                    bool first_move = (origin / 8 == (color == WHITE ? 1 : 6));
+                    if (destination == origin + direction)  return is_empty(destination);
+                    if (first_move && destination == origin + 2 * direction)    return is_empty(origin + direction) && is_empty(destination);
+                    // Moving diagonally onto an empty square is only allowed as an en passant capture.
+                    return destination == en_passant_square && can_capture(origin, destination);
+                }
+                case KNIGHT:    return knight_attacks[origin] & square_bit(destination);
+                case BISHOP:    return bishop_attacks(origin, all_pieces()) & square_bit(destination);
+                case ROOK:      return rook_attacks(origin, all_pieces()) & square_bit(destination);
+                case QUEEN:     return queen_attacks(origin, all_pieces()) & square_bit(destination);
+                case KING:      return king_attacks[origin] & square_bit(destination);
+            }
+            return false;
+        }
+
+        // can_capture() decides if the piece on origin attacks destination. Only pawns capture differently than they otherwise move.
+        bool can_capture(int origin, int destination) const
+        {
+            Piece p = mailbox[origin];
+            return piece_attacks(piece_type(p), piece_color(p), origin, all_pieces()) & square_bit(destination);
+        }
+
+        // The character used to render a square. White pieces are uppercase, black pieces are lowercase, and empty squares are 0s.
+        char display(int square) const
+        {
+            if (is_empty(square))           return '0';
+            char c = "PNBRQK"[type_at(square)];
+            if (color_at(square) == BLACK)  c += 'a' - 'A';
+            return c;
+        }
+
+        void make_move(Move m, UndoStack & history);
+        void unmake_move(UndoStack & history);
+
+        // Return a copy, or a clone, of the board.
+        Board clone()
+        {
+            return (*this);
+        }
+
+};
+
+// A board is plain data, so copying one for another thread or a search is a straight memory copy.
+static_assert(std::is_trivially_copyable<Board>::value, "Board must stay trivially copyable");
+
+// chess_notation_to_integer() accepts a string in chess notation (i.e. "e4") and returns the corresponding array location.
+int chess_notation_to_integer(std::string code);
+
+// integer_to_chess_notation() is the reverse of chess_notation_to_integer(). It turns an array location into a square name like "e4".
+std::string integer_to_chess_notation(int square);
+
+// move_to_string() writes a move as origin and destination squares, followed by the promotion piece if there is one (i.e. "e2e4", "e7e8q").
+std::string move_to_string(Move m);
+
+// check_for_check() returns true if the king of the given color is in check.
+bool check_for_check(const Board * currentBoard, bool white);
+
+// generate_legal_moves() fills list with every legal move for the side to move.
+void generate_legal_moves(const Board & board, MoveList & list);
+
+// generate_legal_captures() fills list with the legal captures and promotions for the side to move.
+void generate_legal_captures(const Board & board, MoveList & list);
+
+// has_legal_move() returns true if the side to move has at least one legal move.
+bool has_legal_move(const Board & board);
+
+// check_for_checkmate() and check_for_stalemate() return true if the player who just moved (white if whites_turn) has checkmated or stalemated their opponent.
+bool check_for_checkmate(const Board & currentBoard, bool whites_turn);
+bool check_for_stalemate(const Board & currentBoard, bool whites_turn);
+
+// perft() counts the positions reachable from the board in exactly depth moves.
+uint64_t perft(Board & board, UndoStack & history, int depth);
+
+// The ways a move can fail to be legal. parse_san(), validate_move() and apply_move() return MOVE_OK or one of these,
+// and move_error_message() describes each one for a player.
+enum MoveError
+{
+    MOVE_OK,
+    BAD_NOTATION,
+    SAME_SQUARE,
+    NO_PIECE_AT_ORIGIN,
+    NOT_YOUR_PIECE,
+    CANNOT_MOVE_THERE,
+    OWN_PIECE_AT_DESTINATION,
+    CANNOT_CAPTURE_THERE,
+    PROMOTION_REQUIRED,
+    NOT_A_PROMOTION,
+    LEAVES_KING_IN_CHECK,
+    KING_WOULD_BE_IN_CHECK,
+    PINNED_PIECE,
+    AMBIGUOUS_MOVE,
+    CASTLING_NOT_SUPPORTED
+};
+
+// parse_move() reads a move typed as two squares and an optional promotion piece (i.e. "e2e4", "e2 e4", "e7e8q", "E7 E8=Q").
+// It only checks the notation. It returns BAD_NOTATION if the text can't be read, and otherwise MOVE_OK with the move filled in.
+MoveError parse_move(const Board & board, const std::string & text, Move & move);
+
+// move_to_san() writes a legal move in standard algebraic notation, naming the origin file or rank only when another piece
+// of the same kind could also move there, and ending with "+" or "#" if it gives check or mate (i.e. "Nbd7", "exd6", "e8=Q+").
+// The move is played on board and history to see whether it checks, then taken back.
+std::string move_to_san(Board & board, Move move, UndoStack & history);
+
+// parse_san() reads a move in standard algebraic notation, as PGN files write them (i.e. "e4", "Nbd7", "exd6", "e8=Q+").
+// Unlike parse_move(), it has to find the piece that moves, so it also checks the move is legal. It returns MOVE_OK with the move
+// filled in, AMBIGUOUS_MOVE if more than one piece fits, or the reason the move isn't legal.
+MoveError parse_san(const Board & board, const std::string & text, Move & move);
+
+// validate_move() returns MOVE_OK if the move is legal for the side to move, and otherwise the first rule it breaks.
+MoveError validate_move(const Board & board, Move move);
+
+// A LegalMoves holds every legal move of one position as a 64x64 bit matrix, with a bitboard of destinations for each origin square.
+// It is filled once per turn, so checking a typed move, or listing where a piece can go, is a single lookup.
+struct LegalMoves
+{
+    Bitboard targets [64];
+
+    // compute() fills the matrix from the legal moves of the side to move.
+    void compute(const Board & board);
+    bool contains(int origin, int destination) const   {return targets[origin] & square_bit(destination);}
+    Bitboard from(int origin) const                     {return targets[origin];}
+};
+
+// This validate_move() gives the same result as the one above, but looks the move up in legal, computed for the same board,
+// instead of generating the legal moves again. A move that isn't there is checked for the exact reason it is illegal.
+MoveError validate_move(const Board & board, const LegalMoves & legal, Move move);
+
+// apply_move() plays the move if it is legal, recording it on history, and returns the same result as validate_move().
+MoveError apply_move(Board & board, Move move, UndoStack & history);
+
+// move_error_message() returns a sentence explaining a MoveError to a player.
+const char * move_error_message(MoveError error);
+
+// Kinds of score a search can store. A lower bound failed high, an upper bound failed low, and an exact score is neither.
+enum Bound {BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT};
+
+// A TTEntry is what a transposition table probe hands back.
+struct TTEntry
+{
+    Move move;
+    int score;
+    int depth;
+    int bound;
+};
+
+// Class "TranspositionTable" remembers search results by position key. It is shared by every search thread without locks.
+// Each 16-byte slot holds a 64-bit data word and the key XORed with that data. If two threads store into a slot at once and
+// their halves get mixed, the XOR no longer gives back the key, so the mixed slot just reads as a miss.
+class TranspositionTable
+{
+    private:
+        struct Slot
+        {
+            std::atomic <uint64_t> check;
+            std::atomic <uint64_t> data;
+        };
+        // Four slots fill one 64-byte cache line, so a probe touches a single line.
+        struct alignas(64) Bucket
+        {
+            Slot slots [4];
+        };
+
+        Bucket * buckets = nullptr;
+        uint64_t bucket_mask = 0;
+        uint8_t generation = 0;
+
+        // The data word packs the move (bits 0-15), score (16-31), depth (32-39), bound (40-41) and generation (42-47).
+        static uint64_t pack(Move move, int score, int depth, int bound, int generation)
+        {
+            return move.data | (uint64_t)(uint16_t)score << 16 | (uint64_t)(uint8_t)depth << 32 | (uint64_t)bound << 40 | (uint64_t)(generation & 63) << 42;
+        }
+        static int data_depth(uint64_t data)        {return (int8_t)(data >> 32);}
+        static int data_bound(uint64_t data)        {return (data >> 40) & 3;}
+        static int data_generation(uint64_t data)   {return (data >> 42) & 63;}
+
+    public:
+        TranspositionTable() {}
+        TranspositionTable(const TranspositionTable &) = delete;
+        TranspositionTable & operator=(const TranspositionTable &) = delete;
+        ~TranspositionTable() {delete [] buckets;}
+
+        // resize() sets the table to the largest power-of-two number of buckets that fits in the given number of megabytes, and clears it.
+        void resize(size_t megabytes)
+        {
+            size_t count = 1;
+            while (count * 2 * sizeof(Bucket) <= (megabytes << 20))  count *= 2;
+            delete [] buckets;
+            buckets = new Bucket [count];
+            bucket_mask = count - 1;
+            clear();
+        }
+
+        void clear()
+        {
+            for (uint64_t i = 0 ; i <= bucket_mask ; i++)
+            {
+                for (Slot & slot : buckets[i].slots)
+                {
+                    slot.check.store(0, std::memory_order_relaxed);
+                    slot.data.store(0, std::memory_order_relaxed);
+                }
+            }
+            generation = 0;
+        }
+
+        size_t size_in_bytes() const {return (bucket_mask + 1) * sizeof(Bucket);}
+
+        // new_search() ages every stored entry, so results from earlier searches are the first to be replaced.
+        void new_search() {generation = (generation + 1) & 63;}
+
+        // probe() looks for the position with the given key and fills entry if it is found.
+        bool probe(uint64_t key, TTEntry & entry) const
+        {
+            const Bucket & bucket = buckets[key & bucket_mask];
+            for (const Slot & slot : bucket.slots)
+            {
+                uint64_t data = slot.data.load(std::memory_order_relaxed);
+                if ((slot.check.load(std::memory_order_relaxed) ^ data) != key || data_bound(data) == BOUND_NONE)  continue;
+                entry.move.data = (uint16_t)data;
+                entry.score = (int16_t)(data >> 16);
+                entry.depth = data_depth(data);
+                entry.bound = data_bound(data);
+                return true;
+            }
+            return false;
+        }
+
+        // store() saves a search result. It overwrites the slot already holding this position if there is one,
+        // and otherwise the slot whose entry is shallowest once older searches are counted against it.
+        void store(uint64_t key, Move move, int score, int depth, int bound)
+        {
+            Bucket & bucket = buckets[key & bucket_mask];
+            Slot * replace = &bucket.slots[0];
+            int worst = 1 << 30;
+            for (Slot & slot : bucket.slots)
+            {
+                uint64_t data = slot.data.load(std::memory_order_relaxed);
+                if ((slot.check.load(std::memory_order_relaxed) ^ data) == key)
+                {
+                    // Keep the old best move if the new result doesn't have one.
+                    if (move == Move()) move.data = (uint16_t)data;
+                    replace = &slot;
+                    break;
+                }
+                int age = (generation - data_generation(data)) & 63;
+                int value = data_bound(data) == BOUND_NONE ? -(1 << 29) : data_depth(data) - 8 * age;
+                if (value < worst)
+                {
+                    worst = value;
+                    replace = &slot;
+                }
+            }
+            uint64_t data = pack(move, score, depth, bound, generation);
+            replace->check.store(key ^ data, std::memory_order_relaxed);
+            replace->data.store(data, std::memory_order_relaxed);
+        }
+
+        // hashfull() estimates how full the table is, in parts per thousand, by counting current entries among the first thousand slots.
+        int hashfull() const
+        {
+            int used = 0;
+            for (int i = 0 ; i < 1000 ; i++)
+            {
+                uint64_t data = buckets[(i / 4) & bucket_mask].slots[i % 4].data.load(std::memory_order_relaxed);
+                if (data_bound(data) != BOUND_NONE && data_generation(data) == generation)  used++;
+            }
+            return used;
+        }
+};
+
+// The transposition table shared by every search. Its size is set with the "hash=<megabytes>" option when the program starts.
+extern TranspositionTable transposition_table;
+const int DEFAULT_HASH_MB = 16;
+
+// Scores are in centipawns from the point of view of the side to move. A mate found n plies from the root scores MATE_SCORE - n.
+// Mates read from a tablebase can lie up to 256 plies beyond the deepest search.
+const int MAX_DEPTH = 64;
+const int INFINITE_SCORE = 32001;
+const int MATE_SCORE = 32000;
+const int MATE_BOUND = MATE_SCORE - MAX_DEPTH - 256;
+
+// A PawnEntry holds what evaluate() needs to know about one arrangement of pawns.
+struct PawnEntry
+{
+    uint64_t key;
+    // The score of the pawn structure from white's point of view, in the middlegame and the endgame: passed pawns gain,
+    // and doubled, isolated and backward pawns lose.
+    int16_t mg, eg;
+    // The files each color has pawns on, one bit per file from a (bit 0) to h.
+    uint8_t files [2];
+    // Each color's passed pawns.
+    Bitboard passed [2];
+};
+
+// score_pawns() works out the pawn structure terms of the pawns on board from scratch.
+void score_pawns(const Board & board, PawnEntry & entry);
+
+const int PAWN_TABLE_SIZE = 8192;
+
+// Class "PawnTable" caches PawnEntry results by pawn key. Pawns only change when a pawn moves, is captured or promotes, so most
+// evaluations in a search find their pawns already scored. Each search thread has its own table, so it needs no locking.
+// A board without pawns has a pawn key of 0, and the empty slots, all zeros, already hold its entry.
+class PawnTable
+{
+    public:
+        // Lookups made, and how many found their pawns. Only the owning thread writes them, but other threads read them.
+        std::atomic <uint64_t> probes {0};
+        std::atomic <uint64_t> hits {0};
+
+        PawnTable() : entries(new PawnEntry [PAWN_TABLE_SIZE]()) {}
+
+        // probe() returns the entry for the pawns on board, scoring them first if they aren't in the table.
+        const PawnEntry & probe(const Board & board)
+        {
+            PawnEntry & entry = entries[board.pawn_key & (PAWN_TABLE_SIZE - 1)];
+            probes.store(probes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            if (entry.key == board.pawn_key)    hits.store(hits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            else                                score_pawns(board, entry);
+            return entry;
+        }
+
+    private:
+        std::unique_ptr <PawnEntry []> entries;
+};
+
+// evaluate() scores the position for the side to move from its material, piece-square and pawn structure scores, blended
+// between the middlegame and the endgame by how much material other than pawns is left. The pawn terms come from pawns if
+// it is given, and are worked out from scratch if not.
+int evaluate(const Board & board, PawnTable * pawns = nullptr);
+
+// is_capture() returns true if the move takes a piece.
+bool is_capture(const Board & board, Move m);
+
+// score_to_string() writes a score the way UCI does: "cp <centipawns>", or "mate <moves>" with a negative count when the side to move is getting mated.
+std::string score_to_string(int score);
+
+// Limits on a search. A zero node or time limit means no limit.
+struct SearchLimits
+{
+    int depth = MAX_DEPTH;
+    uint64_t nodes = 0;
+    // Milliseconds to spend on the move.
+    int movetime = 0;
+    // Number of workers searching the position at once.
+    int threads = 1;
+};
+
+// Class "Search" finds the best move in a position with an alpha-beta negamax search, deepening one ply at a time
+// until it runs out of depth, nodes or time. It works on its own copy of the board and move history.
+// With more than one thread it starts helper searches of the same position (Lazy SMP). They share nothing but the
+// transposition table and the stop flag, and the deepest finished iteration of any worker gives the move.
+class Search
+{
+    public:
+        // Set from any thread to stop the search, and all of its helpers, as soon as possible.
+        std::atomic <bool> stop;
+
+        // Results of the deepest completed iteration.
+        Move best_move;
+        int best_score = 0;
+        int completed_depth = 0;
+        // Positions searched by this worker alone. Only its own thread writes it, but other threads read it.
+        std::atomic <uint64_t> nodes {0};
+        Move pv [MAX_DEPTH];
+        int pv_length = 0;
+
+        // If set, called after each completed iteration, i.e. to print its depth, score, nodes, speed and principal variation.
+        void (*report)(const Search & search) = nullptr;
+
+        // The transposition table the search reads and fills. Games played side by side each give their searches their own.
+        TranspositionTable * table = &transposition_table;
+
+        Search(const Board & position, const UndoStack & moves, SearchLimits search_limits)
+        {
+            board = position;
+            history = moves;
+            limits = search_limits;
+            stop = false;
+            stop_flag = &stop;
+        }
+
+        // run() searches until a limit is reached or stop is set, and returns the best move found.
+        Move run();
+
+        // total_nodes() returns the positions searched by this worker and all of its helpers.
+        uint64_t total_nodes() const
+        {
+            uint64_t total = nodes.load(std::memory_order_relaxed);
+            for (const auto & helper : helpers) total += helper->nodes.load(std::memory_order_relaxed);
+            return total;
+        }
+
+        // pawn_stats() counts the pawn table lookups made by this worker and all of its helpers, and how many found their pawns.
+        void pawn_stats(uint64_t & hits, uint64_t & probes) const
+        {
+            hits = pawns->hits.load(std::memory_order_relaxed);
+            probes = pawns->probes.load(std::memory_order_relaxed);
+            for (const auto & helper : helpers)
+            {
+                hits += helper->pawns->hits.load(std::memory_order_relaxed);
+                probes += helper->pawns->probes.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Milliseconds since the search started.
+        int elapsed() const
+        {
+            return (int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+
+    private:
+        Board board;
+        UndoStack history;
+        SearchLimits limits;
+        std::chrono::steady_clock::time_point start;
+
+        // Worker 0 is the main search. Only it checks the limits and reports iterations.
+        int id = 0;
+        std::atomic <bool> * stop_flag;
+        std::vector <std::unique_ptr <Search>> helpers;
+        // This worker's own pawn structure cache.
+        std::unique_ptr <PawnTable> pawns {new PawnTable()};
+
+        // Triangular table of principal variations: row ply holds the best line found from that ply.
+        Move pv_table [MAX_DEPTH][MAX_DEPTH];
+        int pv_lengths [MAX_DEPTH];
+        // Two quiet moves per ply that recently caused a beta cutoff.
+        Move killers [MAX_DEPTH][2];
+        // How often each quiet move, by side, origin and destination, has caused a cutoff, weighted by depth.
+        int history_scores [2][64][64] = {};
+
+        // iterate() deepens one ply at a time until a limit is reached or the stop flag is set.
+        void iterate();
+
+        // stopped() returns true once the search should unwind. The main worker always finishes its first iteration, so there is always a move to play.
+        bool stopped() const {return *stop_flag && (id > 0 || completed_depth > 0);}
+
+        // count_node() adds one to this worker's node count. No other thread writes it, so a plain load and store is enough.
+        void count_node() {nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);}
+
+        // check_limits() sets stop when the node or time budget runs out. The clock is only read every 1024 nodes.
+        void check_limits()
+        {
+            if (id > 0) return;
+            uint64_t searched = nodes.load(std::memory_order_relaxed);
+            if (limits.nodes && (helpers.empty() ? searched : total_nodes()) >= limits.nodes)  stop = true;
+            if (limits.movetime && (searched & 1023) == 0 && elapsed() >= limits.movetime)    stop = true;
+        }
+
+        // is_draw() returns true if the position is drawn by the 50 move rule or repeats an earlier one.
+        // Only positions since the last capture or pawn move, with the same side to move, can be repeats.
+        bool is_draw() const;
+
+        // score_moves() gives each move an ordering score: the transposition table move, then captures by
+        // most valuable victim and least valuable attacker, then killer moves, then quiet moves by history.
+        void score_moves(MoveList & list, int * scores, Move tt_move, int ply) const;
+
+        // pick_move() swaps the best scored move left in the list into position i, so moves are sorted only as far as they are searched.
+        static void pick_move(MoveList & list, int * scores, int i);
+
+        // quiescence() searches only captures and promotions until the position is quiet, so the evaluation is never taken in the middle of an exchange.
+        int quiescence(int alpha, int beta, int ply);
+
+        // alpha_beta() is the main negamax search. It returns the score of the position to the given depth, within the alpha-beta window.
+        int alpha_beta(int alpha, int beta, int depth, int ply);
+
+        // age_history() halves every history score.
+        void age_history();
+};
+
+// How a game ended, as recorded in a journal.
+enum GameResult {RESULT_NONE, WHITE_WINS, BLACK_WINS, DRAW};
+
+// A journal is a binary file holding one game. It starts with a header and is followed by one 16-bit entry per move,
+// in the order they were played. An entry of 0 (a Move from a1 to a1, which is never legal) takes back the move before it.
+// All numbers are little-endian. The header is:
+//     bytes 0-3     "TCJ1"
+//     byte 4        the GameResult
+//     bytes 6-7     length of the start FEN that follows the header, or 0 for the usual starting position
+//     bytes 8-15    Zobrist key of the start position
+//     bytes 16-19   number of moves in the game once take-backs are counted, as of the last sync
+//     bytes 24-     the start FEN, if there is one
+struct JournalHeader
+{
+    GameResult result = RESULT_NONE;
+    uint64_t start_key = 0;
+    uint32_t move_count = 0;
+    std::string start_fen;
+};
+
+const int JOURNAL_HEADER_SIZE = 24;
+// A journal is synced to disk, and its header's move count brought up to date, after this many entries.
+const int JOURNAL_SYNC_INTERVAL = 16;
+
+// Class "GameJournal" writes a journal as a game is played. Each entry is added with a single write as soon as it is
+// made, so saving is constant time per move and a crash loses at most the move being written.
+class GameJournal
+{
+    public:
+        GameJournal() {}
+        GameJournal(const GameJournal &) = delete;
+        GameJournal & operator=(const GameJournal &) = delete;
+        ~GameJournal() {close();}
+
+        // create() starts a new journal at path, replacing any file there, for a game from start with the moves in history already played.
+        bool create(const std::string & path, const Board & start, const std::string & start_fen, const UndoStack & history);
+        // reopen() continues a journal read by read_journal(), appending after its last entry.
+        bool reopen(const std::string & path, const JournalHeader & header);
+
+        bool is_open() const {return fd >= 0;}
+        // append() records a move, and append_undo() records taking back the last one. Both do nothing if no journal is open.
+        bool append(Move m);
+        bool append_undo();
+        // finish() records the result, syncs the journal and closes it.
+        bool finish(GameResult result);
+        // close() syncs the journal and closes it, leaving the game unfinished.
+        void close();
+
+    private:
+        int fd = -1;
+        // Where the next entry goes. Entries are written there rather than appended, so the header can be rewritten in place.
+        int64_t end = 0;
+        uint32_t move_count = 0;
+        int unsynced = 0;
+        GameResult result = RESULT_NONE;
+
+        bool write_entry(uint16_t entry);
+        bool sync();
+};
+
+// read_journal() reads the journal at path and replays it onto board and history from its start position. The move count in
+// the header is only as recent as the last sync, so the entries themselves are trusted, and a torn final entry is ignored.
+// It returns false, with a reason in error, if the file can't be read or any entry isn't legal.
+bool read_journal(const std::string & path, Board & board, UndoStack & history, JournalHeader & header, std::string & error);
+
+// A GameRecord is one game as stored in a game database: a name for it, where it started, its moves and how it ended.
+struct GameRecord
+{
+    std::string name;
+    std::string start_fen;
+    GameResult result = RESULT_NONE;
+    std::vector <Move> moves;
+};
+
+// One entry of a game database's position index: a position reached in a game, at which ply, and the move played next
+// (an empty Move if the game ended there). Entries are sorted by key, then game, then ply.
+struct PositionEntry
+{
+    uint64_t key;
+    uint32_t game;
+    uint16_t ply;
+    uint16_t next_move;
+};
+static_assert(sizeof(PositionEntry) == 16, "PositionEntry is stored in the file as-is");
+
+// A game database is one file holding many games, laid out so it can be memory-mapped and searched in place.
+// Numbers are in the machine's byte order, which the header records so a file from another kind of machine is refused.
+//     bytes 0-3     "TCDB"
+//     bytes 4-7     0x01020304, in the byte order of the machine that wrote the file
+//     bytes 8-15    number of games
+//     bytes 16-23   file offset of the offset table: one 64-bit file offset per game
+//     bytes 24-31   number of position index entries
+//     bytes 32-39   file offset of the position index: an array of PositionEntry
+//     bytes 64-     the games, each a result byte, a name length byte, a 16-bit start FEN length, a 32-bit move count,
+//                   the name, the start FEN (empty for the usual starting position) and then one 16-bit Move per ply
+const int DATABASE_HEADER_SIZE = 64;
+
+// write_game_database() writes games to a new database file at path, cutting names short at 255 bytes. Every game is replayed
+// to index the positions it reached, and it returns false, with a reason in error, if a game isn't legal or the file can't be written.
+bool write_game_database(const std::string & path, const std::vector <GameRecord> & games, std::string & error);
+
+// Class "GameDatabase" reads a game database through a read-only memory map, so opening one costs the same whatever its
+// size, and only the pages a lookup touches are ever read from disk.
+class GameDatabase
+{
+    public:
+        GameDatabase() {}
+        GameDatabase(const GameDatabase &) = delete;
+        GameDatabase & operator=(const GameDatabase &) = delete;
+        ~GameDatabase() {close();}
+
+        // open() maps the database at path. It returns false, with a reason in error, if the file isn't a valid database.
+        bool open(const std::string & path, std::string & error);
+        void close();
+
+        uint64_t game_count() const {return games;}
+        uint64_t position_count() const {return entries;}
+
+        // game() decodes game number index into record.
+        void game(uint64_t index, GameRecord & record) const;
+
+        // find() returns the index entries for every time a game reached the position with the given key, by binary search.
+        std::pair <const PositionEntry *, const PositionEntry *> find(uint64_t key) const;
+
+    private:
+        const unsigned char * data = nullptr;
+        size_t size = 0;
+        uint64_t games = 0;
+        const uint64_t * offsets = nullptr;
+        uint64_t entries = 0;
+        const PositionEntry * index = nullptr;
+};
+
+
+// A PgnGame is one game of a PGN file, with its moves in standard algebraic notation. The FEN and Result tags are kept apart
+// from the others, which are in the order they were written.
+struct PgnGame
+{
+    std::vector <std::pair <std::string, std::string>> tags;
+    std::string start_fen;
+    std::string result;
+    std::vector <std::string> moves;
+    int line = 0;
+};
+
+// Class "PgnReader" reads the games of a PGN file one at a time, so a file of any size can be streamed.
+// Comments, variations, move numbers and annotation glyphs are skipped.
+class PgnReader
+{
+    public:
+        PgnReader(std::istream & input) : input(input) {}
+
+        // next() reads the next game into game, noting the line it starts on. It returns false once no game is left.
+        bool next(PgnGame & game);
+
+    private:
+        std::istream & input;
+        std::string pending;
+        int line_number = 0;
+        int comment_depth = 0;
+};
+
+// write_pgn_game() writes a game in PGN, with its tags, numbered moves wrapped to fit in 80 columns, and its result.
+void write_pgn_game(std::ostream & output, const PgnGame & game);
+
+// A BookEntry is one move of an opening book, with its weight: how strongly it is recommended against the others.
+struct BookEntry
+{
+    uint64_t key;
+    Move move;
+    uint16_t weight;
+};
+
+// Opening books use the Polyglot file layout: 16-byte entries sorted by key, each a 64-bit key, a 16-bit move, a 16-bit weight
+// and a 32-bit learn value, all big-endian. A move holds the destination in bits 0-5, the origin in bits 6-11 and any promotion
+// piece, from 1 for a knight to 4 for a queen, in bits 12-14.
+const int BOOK_ENTRY_SIZE = 16;
+
+// Polyglot's Random64 table, as published with the book format. polyglot_key() explains the layout.
+extern const uint64_t polyglot_random [781];
+
+// polyglot_key() returns the key Polyglot gives the position: the Random64 numbers of every piece on its square, the en passant
+// file if a pawn can capture there, and white to move, XORed together. This program never has castling rights.
+uint64_t polyglot_key(const Board & board);
+
+// book_key() returns the key opening books are sorted by. It is polyglot_key() once the Random64 table in textchess.cpp
+// is complete, so books made by other Polyglot tools match, and Board::key until then.
+uint64_t book_key(const Board & board);
+
+// write_opening_book() writes entries to a new book at path. It returns false, with a reason in error, if it can't be written.
+bool write_opening_book(const std::string & path, std::vector <BookEntry> entries, std::string & error);
+
+// Class "OpeningBook" reads an opening book through a read-only memory map and binary search, so a probe never allocates or
+// reads the file beyond the pages it touches. Moves are checked against the board, and any that aren't legal are left out.
+class OpeningBook
+{
+    public:
+        OpeningBook() {}
+        OpeningBook(const OpeningBook &) = delete;
+        OpeningBook & operator=(const OpeningBook &) = delete;
+        ~OpeningBook() {close();}
+
+        // open() maps the book at path. It returns false, with a reason in error, if the file isn't a book.
+        bool open(const std::string & path, std::string & error);
+        void close();
+        bool is_open() const {return opened;}
+
+        size_t size_in_entries() const {return entries;}
+
+        // probe() fills moves and weights with up to max book moves for the position, most recommended first, and returns how many.
+        int probe(const Board & board, Move * moves, int * weights, int max) const;
+
+        // pick() chooses a book move at random, with chances in proportion to the weights, using random as the roll of the dice.
+        // It returns an empty Move if the position isn't in the book.
+        Move pick(const Board & board, uint64_t random) const;
+
+    private:
+        const unsigned char * data = nullptr;
+        size_t size = 0;
+        size_t entries = 0;
+        bool opened = false;
+
+        uint64_t key_at(size_t index) const;
+        // first() returns the index of the first entry whose key isn't below key.
+        size_t first(uint64_t key) const;
+        // move_at() decodes the move and weight of an entry. It returns an empty Move if the move isn't among the legal moves of board.
+        Move move_at(const Board & board, const LegalMoves & legal, size_t index, int & weight) const;
+};
+
+// The most pieces, kings included, an endgame tablebase can hold.
+const int TABLEBASE_MAX_PIECES = 5;
+
+// A TablebaseReport describes one table made by Tablebases::generate().
+struct TablebaseReport
+{
+    std::string name;
+    // Positions indexed, and how those that can occur divide into wins, draws and losses for the side to move.
+    uint64_t positions = 0;
+    uint64_t wins = 0, draws = 0, losses = 0;
+    // The longest distance to mate in the table, in plies.
+    int longest = 0;
+    double seconds = 0;
+    // Memory used while generating, and the size of the finished table.
+    size_t working_bytes = 0;
+    size_t table_bytes = 0;
+};
+
+struct Tablebase;
+
+// Class "Tablebases" holds endgame tablebases: for every position with a given set of pieces (i.e. "KRPvKR", white's first),
+// whether the side to move wins, draws or loses, and how many plies it takes to mate. Tables are made by retrograde analysis,
+// working back from every checkmate, and each is kept in a file named after its pieces (i.e. "KRPvKR.tctb").
+// Positions are taken without en passant rights, and without the 50 move rule.
+class Tablebases
+{
+    public:
+        Tablebases();
+        ~Tablebases();
+        Tablebases(const Tablebases &) = delete;
+        Tablebases & operator=(const Tablebases &) = delete;
+
+        // load() maps every table in directory. It returns false, with a reason in error, if one can't be read.
+        bool load(const std::string & directory, std::string & error);
+
+        // generate() makes the table for the given pieces in directory, using threads threads. The tables its captures and
+        // promotions lead to are loaded from directory if they are there, and made first if not. reports gets an entry for
+        // each table made. It returns false, with a reason in error, if the pieces can't be read or a table can't be written.
+        bool generate(const std::string & material, const std::string & directory, int threads, std::vector <TablebaseReport> & reports, std::string & error);
+
+        // probe() looks up the position on board. It returns false if no table holds it. Otherwise it sets wdl to 1, 0 or -1
+        // for a win, draw or loss for the side to move, and dtm to the plies until mate (0 in a draw).
+        bool probe(const Board & board, int & wdl, int & dtm) const
+        {
+            if (popcount(board.all_pieces()) > largest || board.en_passant_square >= 0)    return false;
+            return probe_table(board, wdl, dtm);
+        }
+
+        // The most pieces in any table held, or 0 if there are none.
+        int pieces() const {return largest;}
+        size_t size() const {return tables.size();}
+
+    private:
+        std::vector <std::unique_ptr <Tablebase>> tables;
+        // The tables sorted by a key made from their piece counts, for binary search.
+        std::vector <std::pair <uint32_t, const Tablebase *>> index;
+        int largest = 0;
+
+        bool probe_table(const Board & board, int & wdl, int & dtm) const;
+        // code_of() returns the stored code of the position on board, or -1 if no table holds it.
+        int code_of(const Board & board) const;
+        const Tablebase * find(uint32_t material) const;
+        void add(std::unique_ptr <Tablebase> table);
+        bool generate(uint32_t material, const std::string & directory, int threads, std::vector <TablebaseReport> & reports, std::string & error);
+        bool build(Tablebase & table, int threads, TablebaseReport & report, std::string & error) const;
+};
+
+// The tablebases used by every search. They are loaded with the "tb=<directory>" option when the program starts.
+extern Tablebases tablebases;
+
+#endif